@@ -0,0 +1,328 @@
+#include "batch.h"
+#include "bounds.h"
+#include "csv_data.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct BatchJob
+{
+    size_t line=0;
+    std::map<std::string, std::string> fields;
+};
+
+struct BatchResult
+{
+    bool success=false;
+    std::string error;
+    size_t points=0;
+    double load_ms=0.0;
+    double render_ms=0.0;
+
+    // held by the plotter of the worker after the job, see PlotContextBytes
+    size_t context_bytes=0;
+};
+
+double MillisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Splits a job line into key=value pairs, values may be double quoted.
+bool ParseJobLine(const std::string& line, BatchJob* job, std::string* error)
+{
+    size_t i = 0;
+
+    while (i < line.size())
+    {
+        while (i < line.size() && std::isspace((unsigned char)line[i]))
+            i++;
+        if (i == line.size())
+            break;
+
+        const size_t eq = line.find('=', i);
+        if (eq == std::string::npos)
+        {
+            *error = "expected key=value at '" + line.substr(i) + "'";
+            return false;
+        }
+        const std::string key = line.substr(i, eq - i);
+        std::string value;
+
+        i = eq + 1;
+        if (i < line.size() && line[i] == '"')
+        {
+            const size_t close = line.find('"', i + 1);
+            if (close == std::string::npos)
+            {
+                *error = "unterminated quote in " + key;
+                return false;
+            }
+            value = line.substr(i + 1, close - i - 1);
+            i = close + 1;
+        }
+        else
+        {
+            const size_t start = i;
+            while (i < line.size() && !std::isspace((unsigned char)line[i]))
+                i++;
+            value = line.substr(start, i - start);
+        }
+
+        job->fields[key] = value;
+    }
+
+    return true;
+}
+
+bool ReadJobs(const std::string& filename, std::vector<BatchJob>* jobs)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Cannot open job file '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    std::string line;
+    size_t number = 0;
+    bool success = true;
+
+    while (std::getline(file, line))
+    {
+        number++;
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        BatchJob job;
+        std::string error;
+        job.line = number;
+        if (!ParseJobLine(line, &job, &error))
+        {
+            std::cerr << filename << ":" << number << ": " << error << std::endl;
+            success = false;
+            continue;
+        }
+        jobs->push_back(job);
+    }
+
+    return success;
+}
+
+// "A<separator>B" into two numbers.
+bool ParsePair(const std::string& text, char separator, double* a, double* b)
+{
+    const size_t at = text.find(separator);
+    if (at == std::string::npos)
+        return false;
+
+    char* end;
+    *a = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + at)
+        return false;
+    *b = std::strtod(text.c_str() + at + 1, &end);
+    return end != text.c_str() + at + 1 && *end == '\0';
+}
+
+// Sets up plot_data of the calling thread for the job.
+bool ConfigureJob(const BatchJob& job, std::string* error)
+{
+    const std::map<std::string, std::string>& f = job.fields;
+    std::map<std::string, std::string>::const_iterator it;
+    double a, b;
+
+    if ((it = f.find("size")) != f.end())
+    {
+        if (!ParsePair(it->second, 'x', &a, &b) || a < 1 || b < 1)
+        {
+            *error = "bad size '" + it->second + "'";
+            return false;
+        }
+        plot_data.pix_x = (uint32_t)a;
+        plot_data.pix_y = (uint32_t)b;
+    }
+
+    if ((it = f.find("style")) != f.end())
+        plot_data.line_type = std::wstring(it->second.begin(), it->second.end());
+
+    if ((it = f.find("title")) != f.end())
+        plot_data.plot_name = std::wstring(it->second.begin(), it->second.end());
+
+    if ((it = f.find("color")) != f.end())
+    {
+        double rgb[3];
+        if (std::sscanf(it->second.c_str(), "%lf,%lf,%lf", &rgb[0], &rgb[1], &rgb[2]) != 3)
+        {
+            *error = "bad color '" + it->second + "'";
+            return false;
+        }
+        for (int c = 0; c < 3; c++)
+            plot_data.rgb[c] = rgb[c];
+    }
+
+    for (const char* range : { "x", "y" })
+    {
+        if ((it = f.find(range)) != f.end()
+            && (!ParsePair(it->second, ':', &a, &b) || !(a < b)))
+        {
+            *error = std::string("bad ") + range + " range '" + it->second + "'";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RunJob(const BatchJob& job, const PlotData& defaults, BatchResult* result)
+{
+    const std::map<std::string, std::string>& f = job.fields;
+
+    if (!f.count("data") || !f.count("out"))
+    {
+        result->error = "needs data= and out=";
+        return;
+    }
+
+    plot_data = defaults;
+    if (!ConfigureJob(job, &result->error))
+        return;
+
+    Clock::time_point start = Clock::now();
+    std::vector<double> xs, ys;
+    if (!LoadCsvData(f.at("data"), CsvOptions(), &xs, &ys, nullptr,
+                     &result->error))
+    {
+        return;
+    }
+    if (xs.empty())
+    {
+        result->error = "no points in '" + f.at("data") + "'";
+        return;
+    }
+    result->points = xs.size();
+    result->load_ms = MillisecondsSince(start);
+
+    start = Clock::now();
+    ScatterPlotSeries* series = NewLineSeries(0);
+    series->xs->swap(xs);
+    series->ys->swap(ys);
+
+    const std::string& out = f.at("out");
+    double xmin, xmax, ymin = 0.0, ymax = 0.0;
+    bool success;
+
+    if (f.count("x") || f.count("y"))
+    {
+        if (f.count("x"))
+        {
+            ParsePair(f.at("x"), ':', &xmin, &xmax);
+        }
+        else
+        {
+            const MinMax mm = FindMinMax(series->xs->data(), series->xs->size());
+            xmin = mm.min;
+            xmax = mm.max;
+        }
+        if (f.count("y"))
+            ParsePair(f.at("y"), ':', &ymin, &ymax);
+
+        success = GeneratePlotInRange(out, series, xmin, xmax, ymin, ymax);
+    }
+    else
+    {
+        success = GeneratePlot(out, series);
+    }
+
+    result->render_ms = MillisecondsSince(start);
+    result->context_bytes = PlotContextBytes();
+    result->success = success;
+    if (!success)
+        result->error = "rendering or writing '" + out + "' failed";
+}
+
+}
+
+bool RunBatchJobs(const std::string& jobs_filename, const PlotData& defaults)
+{
+    std::vector<BatchJob> jobs;
+    const bool parsed = ReadJobs(jobs_filename, &jobs);
+
+    PlotData job_defaults = defaults;
+    job_defaults.line_type = L"solid";
+    job_defaults.plot_name = L"";
+    job_defaults.rgb[0] = job_defaults.rgb[1] = job_defaults.rgb[2] = 0.0;
+    job_defaults.gpu_series = false;
+    job_defaults.xs.clear();
+    job_defaults.ys.clear();
+
+    std::vector<BatchResult> results(jobs.size());
+    const Clock::time_point start = Clock::now();
+
+    // one job per chunk; plotting calls inside a job run serially on its
+    // worker, so the pool is busy with whole jobs
+    ParallelFor(0, jobs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; j++)
+        {
+            try
+            {
+                RunJob(jobs[j], job_defaults, &results[j]);
+            }
+            catch (const std::exception& e)
+            {
+                results[j].success = false;
+                results[j].error = e.what();
+            }
+        }
+    });
+
+    const double wall_ms = MillisecondsSince(start);
+    std::cout << std::fixed << std::setprecision(2);
+    double busy_ms = 0.0;
+    size_t failed = 0;
+    size_t context_bytes = 0;
+
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        const BatchResult& r = results[j];
+        const std::map<std::string, std::string>& f = jobs[j].fields;
+        const std::string out = f.count("out") ? f.at("out") : "?";
+
+        busy_ms += r.load_ms + r.render_ms;
+        context_bytes = std::max(context_bytes, r.context_bytes);
+        std::cout << std::setw(6) << jobs[j].line << "  " << std::left
+                  << std::setw(40) << out << std::right << " ";
+        if (r.success)
+        {
+            std::cout << std::setw(10) << r.points << " pts  load "
+                      << std::setw(8) << r.load_ms << " ms  render "
+                      << std::setw(8) << r.render_ms << " ms" << std::endl;
+        }
+        else
+        {
+            failed++;
+            std::cout << "FAILED: " << r.error << std::endl;
+        }
+    }
+
+    std::cout << jobs.size() << " jobs, " << failed << " failed, " << wall_ms
+              << " ms on " << ParallelWorkers() << " workers (" << busy_ms
+              << " ms of job time), largest plot context "
+              << context_bytes / 1024 << " KiB" << std::endl;
+
+    return parsed && failed == 0;
+}
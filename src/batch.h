@@ -0,0 +1,35 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include "plotter.h"
+
+/**
+ * @brief Renders every job of a job file without any window or GL context,
+ * spread over the worker pool, and prints a summary with the time each job
+ * took.
+ *
+ * One job per line, as key=value pairs separated by spaces; values with
+ * spaces go in double quotes. Empty lines and lines starting with '#' are
+ * skipped.
+ *
+ *     data=run1.txt out=run1.png size=800x600 x=-5:5 y=0:1 style=dotted
+ *         color=1,0,0 title="Run 1"
+ *
+ * - data:  CSV/TSV text file with an x and a y value per line, separated by
+ *          spaces, tabs, a comma or a semicolon (required)
+ * - out:   output file, its extension picks the format (required)
+ * - size:  plot size in pixels, WIDTHxHEIGHT
+ * - x, y:  plot range, MIN:MAX; taken from the data when left out
+ * - style: solid, dashed, dotted, dotdash, longdash or twodash
+ * - color: line color as r,g,b in [0, 1]
+ * - title: plot title
+ *
+ * Everything not given in a job is taken from defaults, with lines solid
+ * and black unless the job says otherwise.
+ *
+ * @return true if every job succeeded.
+ */
+bool RunBatchJobs(const std::string& jobs_filename, const PlotData& defaults);
+
+#endif // BATCH_H
@@ -0,0 +1,67 @@
+#include "binary_data.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+
+bool LoadBinaryData(BinaryData* data, const std::string& filename,
+    BinaryType type, BinaryLayout layout, size_t header_bytes,
+    std::string* error)
+{
+    CloseBinaryData(data);
+
+    if (!MapFile(&data->file, filename, error))
+        return false;
+
+    const size_t value_size = type == BinaryType::Float64 ? 8 : 4;
+    if (header_bytes % value_size != 0 || header_bytes >= data->file.size
+        || (data->file.size - header_bytes) % (value_size * 2) != 0)
+    {
+        *error = "the size of '" + filename
+            + "' does not fit x/y pairs of the given type after the header";
+        CloseBinaryData(data);
+        return false;
+    }
+
+    const size_t count = (data->file.size - header_bytes) / (value_size * 2);
+    const uint8_t* values = data->file.data + header_bytes;
+    const bool pairs = layout == BinaryLayout::Pairs;
+
+    if (type == BinaryType::Float64)
+    {
+        const double* v = (const double*)values;
+        data->xs = v;
+        data->ys = pairs ? v + 1 : v + count;
+        data->stride = pairs ? 2 : 1;
+    }
+    else
+    {
+        // widened into the same layout, then the mapping is not needed
+        const float* v = (const float*)values;
+        data->widened.resize(count * 2);
+        double* w = data->widened.data();
+
+        ParallelFor(0, count * 2, 1 << 20, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                w[i] = v[i];
+        });
+
+        data->xs = w;
+        data->ys = pairs ? w + 1 : w + count;
+        data->stride = pairs ? 2 : 1;
+        UnmapFile(&data->file);
+    }
+
+    data->count = count;
+    return true;
+}
+
+void CloseBinaryData(BinaryData* data)
+{
+    UnmapFile(&data->file);
+    data->xs = nullptr;
+    data->ys = nullptr;
+    data->stride = 1;
+    data->count = 0;
+    data->widened.clear();
+    data->widened.shrink_to_fit();
+}
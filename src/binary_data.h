@@ -0,0 +1,56 @@
+#ifndef BINARY_DATA_H
+#define BINARY_DATA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+enum class BinaryType
+{
+    Float64,
+    Float32,
+};
+
+// Pairs: x0 y0 x1 y1 ...; Columns: all x values, then all y values.
+enum class BinaryLayout
+{
+    Pairs,
+    Columns,
+};
+
+// An x/y data file mapped into memory. Point i is
+// (xs[i * stride], ys[i * stride]), the layout MinMaxPyramid takes.
+struct BinaryData
+{
+    const double* xs=nullptr;
+    const double* ys=nullptr;
+    size_t stride=1;
+    size_t count=0;
+
+    MappedFile file;
+
+    // float32 values widened to double, empty for float64 files
+    std::vector<double> widened;
+};
+
+/**
+ * @brief Maps a headerless binary file of native endian x/y values, after
+ * skipping header_bytes, read-only into memory.
+ *
+ * Float64 data is used in place: xs/ys point into the mapping and pages
+ * are only read in as the plot touches them, so files far larger than RAM
+ * can be plotted. Float32 data is widened to double once, which takes twice
+ * the file size in memory.
+ *
+ * @return false with a message in error if the file cannot be mapped or
+ * its size does not fit the type and layout.
+ */
+bool LoadBinaryData(BinaryData* data, const std::string& filename,
+    BinaryType type, BinaryLayout layout, size_t header_bytes,
+    std::string* error);
+
+// Unmaps the file; xs/ys are invalid afterwards.
+void CloseBinaryData(BinaryData* data);
+
+#endif // BINARY_DATA_H
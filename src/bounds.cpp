@@ -0,0 +1,157 @@
+#include "bounds.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BOUNDS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(BOUNDS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define BOUNDS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Arrays below this size are not worth handing to other threads.
+const size_t PARALLEL_MIN_COUNT = size_t(1) << 20;
+const size_t PARALLEL_GRAIN = size_t(1) << 18;
+
+MinMax Empty()
+{
+    return { INFINITY, -INFINITY };
+}
+
+MinMax Combine(const MinMax& a, const MinMax& b)
+{
+    return { std::min(a.min, b.min), std::max(a.max, b.max) };
+}
+
+MinMax MinMaxScalar(const double* values, size_t n)
+{
+    MinMax r = Empty();
+    for (size_t i = 0; i < n; i++)
+    {
+        const double v = values[i];
+        if (std::isfinite(v))
+        {
+            r.min = std::min(r.min, v);
+            r.max = std::max(r.max, v);
+        }
+    }
+    return r;
+}
+
+#ifdef BOUNDS_SSE2
+// v - v is 0 for finite values and NaN for NaN and +-inf, so comparing it to
+// zero masks out everything that cannot be plotted.
+MinMax MinMaxSSE2(const double* values, size_t n)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d pos_inf = _mm_set1_pd(INFINITY);
+    const __m128d neg_inf = _mm_set1_pd(-INFINITY);
+    __m128d lo0 = pos_inf, lo1 = pos_inf;
+    __m128d hi0 = neg_inf, hi1 = neg_inf;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128d a = _mm_loadu_pd(values + i);
+        const __m128d b = _mm_loadu_pd(values + i + 2);
+        const __m128d fa = _mm_cmpeq_pd(_mm_sub_pd(a, a), zero);
+        const __m128d fb = _mm_cmpeq_pd(_mm_sub_pd(b, b), zero);
+
+        lo0 = _mm_min_pd(lo0, _mm_or_pd(_mm_and_pd(fa, a),
+                                        _mm_andnot_pd(fa, pos_inf)));
+        lo1 = _mm_min_pd(lo1, _mm_or_pd(_mm_and_pd(fb, b),
+                                        _mm_andnot_pd(fb, pos_inf)));
+        hi0 = _mm_max_pd(hi0, _mm_or_pd(_mm_and_pd(fa, a),
+                                        _mm_andnot_pd(fa, neg_inf)));
+        hi1 = _mm_max_pd(hi1, _mm_or_pd(_mm_and_pd(fb, b),
+                                        _mm_andnot_pd(fb, neg_inf)));
+    }
+
+    double lo[2], hi[2];
+    _mm_storeu_pd(lo, _mm_min_pd(lo0, lo1));
+    _mm_storeu_pd(hi, _mm_max_pd(hi0, hi1));
+
+    MinMax r = { std::min(lo[0], lo[1]), std::max(hi[0], hi[1]) };
+    return Combine(r, MinMaxScalar(values + i, n - i));
+}
+#endif
+
+#ifdef BOUNDS_AVX2
+__attribute__((target("avx2"))) MinMax MinMaxAVX2(const double* values,
+                                                  size_t n)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d pos_inf = _mm256_set1_pd(INFINITY);
+    const __m256d neg_inf = _mm256_set1_pd(-INFINITY);
+    __m256d lo0 = pos_inf, lo1 = pos_inf;
+    __m256d hi0 = neg_inf, hi1 = neg_inf;
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256d a = _mm256_loadu_pd(values + i);
+        const __m256d b = _mm256_loadu_pd(values + i + 4);
+        const __m256d fa =
+            _mm256_cmp_pd(_mm256_sub_pd(a, a), zero, _CMP_EQ_OQ);
+        const __m256d fb =
+            _mm256_cmp_pd(_mm256_sub_pd(b, b), zero, _CMP_EQ_OQ);
+
+        lo0 = _mm256_min_pd(lo0, _mm256_blendv_pd(pos_inf, a, fa));
+        lo1 = _mm256_min_pd(lo1, _mm256_blendv_pd(pos_inf, b, fb));
+        hi0 = _mm256_max_pd(hi0, _mm256_blendv_pd(neg_inf, a, fa));
+        hi1 = _mm256_max_pd(hi1, _mm256_blendv_pd(neg_inf, b, fb));
+    }
+
+    double lo[4], hi[4];
+    _mm256_storeu_pd(lo, _mm256_min_pd(lo0, lo1));
+    _mm256_storeu_pd(hi, _mm256_max_pd(hi0, hi1));
+
+    MinMax r = { std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3])),
+                 std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3])) };
+    return Combine(r, MinMaxScalar(values + i, n - i));
+}
+#endif
+
+typedef MinMax (*MinMaxKernel)(const double*, size_t);
+
+MinMaxKernel SelectKernel()
+{
+#ifdef BOUNDS_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return MinMaxAVX2;
+#endif
+#ifdef BOUNDS_SSE2
+    return MinMaxSSE2;
+#else
+    return MinMaxScalar;
+#endif
+}
+
+}
+
+MinMax FindMinMax(const double* values, size_t n)
+{
+    static const MinMaxKernel kernel = SelectKernel();
+
+    if (n < PARALLEL_MIN_COUNT || ParallelWorkers() == 1)
+        return kernel(values, n);
+
+    std::vector<MinMax> partial((n + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN,
+                                Empty());
+    ParallelFor(0, n, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+        partial[begin / PARALLEL_GRAIN] = kernel(values + begin, end - begin);
+    });
+
+    MinMax r = Empty();
+    for (const MinMax& p : partial)
+        r = Combine(r, p);
+    return r;
+}
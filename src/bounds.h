@@ -0,0 +1,22 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cstddef>
+
+struct MinMax
+{
+    // min > max when there were no finite values
+    double min;
+    double max;
+};
+
+/**
+ * @brief Smallest and largest finite value of the array in a single pass.
+ * NaN and infinities are skipped, since they cannot be placed on an axis.
+ *
+ * Uses AVX2 or SSE2 when the CPU has them and splits large arrays over the
+ * worker pool.
+ */
+MinMax FindMinMax(const double* values, size_t n);
+
+#endif // BOUNDS_H
@@ -0,0 +1,486 @@
+#include "canvas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+uint8_t ToByte(double channel)
+{
+    return (uint8_t)std::lround(std::min(std::max(channel, 0.0), 1.0) * 255.0);
+}
+
+// Blends color over the pixel at dst, same "over" operator as pbPlots uses.
+inline void BlendPixel(uint8_t* dst, const Color8& color)
+{
+    if (color.a == 255)
+    {
+        dst[0] = color.r;
+        dst[1] = color.g;
+        dst[2] = color.b;
+        dst[3] = 255;
+        return;
+    }
+    if (color.a == 0)
+        return;
+
+    const int ai = color.a;
+    const int ab = dst[3] * (255 - ai) / 255;
+    const int ao = ai + ab;
+
+    dst[0] = (uint8_t)((color.r * ai + dst[0] * ab) / ao);
+    dst[1] = (uint8_t)((color.g * ai + dst[1] * ab) / ao);
+    dst[2] = (uint8_t)((color.b * ai + dst[2] * ab) / ao);
+    dst[3] = (uint8_t)ao;
+}
+
+// The canvas rectangle, narrowed down to clip if there is one.
+CanvasClip Limits(const Canvas* canvas, const CanvasClip* clip)
+{
+    CanvasClip limits;
+    limits.x1 = (int)canvas->width - 1;
+    limits.y1 = (int)canvas->height - 1;
+
+    if (clip)
+    {
+        limits.x0 = std::max(limits.x0, clip->x0);
+        limits.y0 = std::max(limits.y0, clip->y0);
+        limits.x1 = std::min(limits.x1, clip->x1);
+        limits.y1 = std::min(limits.y1, clip->y1);
+    }
+    return limits;
+}
+
+inline void PutPixel(Canvas* canvas, const CanvasClip& limits, int x, int y,
+    const Color8& color)
+{
+    if (x < limits.x0 || y < limits.y0 || x > limits.x1 || y > limits.y1)
+        return;
+
+    BlendPixel(canvas->rgba.data() + ((size_t)y * canvas->width + x) * 4,
+               color);
+}
+
+// Fills the horizontal span [x0, x1] of row y.
+void FillSpan(Canvas* canvas, const CanvasClip& limits, int x0, int x1, int y,
+    const Color8& color)
+{
+    if (y < limits.y0 || y > limits.y1)
+        return;
+
+    x0 = std::max(x0, limits.x0);
+    x1 = std::min(x1, limits.x1);
+    if (x0 > x1)
+        return;
+
+    uint8_t* dst = canvas->rgba.data() + ((size_t)y * canvas->width + x0) * 4;
+    for (int x = x0; x <= x1; x++, dst += 4)
+        BlendPixel(dst, color);
+}
+
+int BrushSize(double thickness)
+{
+    return std::max(1, (int)std::lround(thickness));
+}
+
+// Square brush of size x size pixels centered on (x, y).
+void DrawBrush(Canvas* canvas, const CanvasClip& limits, int x, int y,
+    int size, const Color8& color)
+{
+    const int x0 = x - size / 2;
+    const int y0 = y - size / 2;
+
+    for (int j = 0; j < size; j++)
+        FillSpan(canvas, limits, x0, x0 + size - 1, y0 + j, color);
+}
+
+// Number of pixels Bresenham visits from (x0, y0) to (x1, y1).
+int BresenhamSteps(int x0, int y0, int x1, int y1)
+{
+    return std::max(std::abs(x1 - x0), std::abs(y1 - y0)) + 1;
+}
+
+// Largest integer not above a / b, for b > 0.
+inline int64_t FloorDiv(int64_t a, int64_t b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Range [*first, *last] of the steps k of a walk whose position along one
+// axis is start + dir * floor((2 * k * d + major) / (2 * major)) that stay
+// within [lo, hi], narrowed down from what it was; false once it is empty.
+bool NarrowSteps(int start, int dir, int d, int major, int lo, int hi,
+    int* first, int* last)
+{
+    const int64_t p_lo = dir > 0 ? lo - start : start - hi;
+    const int64_t p_hi = dir > 0 ? hi - start : start - lo;
+
+    if (d == 0)
+        return p_lo <= 0 && 0 <= p_hi && *first <= *last;
+
+    const int64_t m2 = 2 * (int64_t)major;
+    const int64_t d2 = 2 * (int64_t)d;
+    const int64_t k_lo = -FloorDiv(major - m2 * p_lo, d2);
+    const int64_t k_hi = FloorDiv(m2 * (p_hi + 1) - major - 1, d2);
+
+    *first = (int)std::max<int64_t>(*first, k_lo);
+    *last = (int)std::min<int64_t>(*last, k_hi);
+    return *first <= *last;
+}
+
+// Steps of the walk from (x0, y0) to (x1, y1) where a brush of the given
+// size reaches into limits; false if there are none.
+bool StepsWithin(int x0, int y0, int x1, int y1, int size,
+    const CanvasClip& limits, int* first, int* last)
+{
+    const int dx = std::abs(x1 - x0);
+    const int dy = std::abs(y1 - y0);
+    const int major = std::max(dx, dy);
+    const int below = size / 2;
+    const int above = size - 1 - below;
+
+    *first = 0;
+    *last = major;
+    if (major == 0)
+    {
+        return x0 + above >= limits.x0 && x0 - below <= limits.x1
+            && y0 + above >= limits.y0 && y0 - below <= limits.y1;
+    }
+
+    return NarrowSteps(x0, x0 < x1 ? 1 : -1, dx, major, limits.x0 - above,
+                       limits.x1 + below, first, last)
+        && NarrowSteps(y0, y0 < y1 ? 1 : -1, dy, major, limits.y0 - above,
+                       limits.y1 + below, first, last);
+}
+
+// Visits the pixels of steps first to last of Bresenham's walk from
+// (x0, y0) to (x1, y1). Step k lies k pixels along the major axis and
+// k * minor / major, rounded half up, along the other; the usual error
+// term walk picks the same pixels, but this one can start anywhere, so a
+// clipped line only walks the part of its path inside the clip.
+template <typename Plot>
+void Bresenham(int x0, int y0, int x1, int y1, int first, int last,
+    Plot plot)
+{
+    const int dx = std::abs(x1 - x0);
+    const int dy = std::abs(y1 - y0);
+    const int sx = x0 < x1 ? 1 : -1;
+    const int sy = y0 < y1 ? 1 : -1;
+    const int64_t m2 = 2 * (int64_t)std::max(dx, dy);
+
+    if (m2 == 0)
+    {
+        plot(x0, y0);
+        return;
+    }
+
+    // position along each axis at step first, as quotient and remainder of
+    // 2 * k * d + major by 2 * major
+    int64_t rx = 2 * (int64_t)first * dx + m2 / 2;
+    int64_t ry = 2 * (int64_t)first * dy + m2 / 2;
+    int x = x0 + sx * (int)(rx / m2);
+    int y = y0 + sy * (int)(ry / m2);
+    rx %= m2;
+    ry %= m2;
+
+    for (int k = first; k <= last; k++)
+    {
+        plot(x, y);
+
+        rx += 2 * dx;
+        if (rx >= m2)
+        {
+            rx -= m2;
+            x += sx;
+        }
+        ry += 2 * dy;
+        if (ry >= m2)
+        {
+            ry -= m2;
+            y += sy;
+        }
+    }
+}
+
+// Corners of an upward pointing triangle inscribed in a circle of the given
+// radius, apex first.
+void TriangleCorners(int x, int y, int height, int xs[3], int ys[3])
+{
+    const double half_base = height * 0.8660254037844386; // cos(30 deg)
+
+    xs[0] = x;
+    ys[0] = y - height;
+    xs[1] = (int)std::lround(x + half_base);
+    ys[1] = y + height / 2;
+    xs[2] = (int)std::lround(x - half_base);
+    ys[2] = y + height / 2;
+}
+
+}
+
+Color8 ToColor8(const RGBA* color)
+{
+    Color8 c;
+    c.r = ToByte(color->r);
+    c.g = ToByte(color->g);
+    c.b = ToByte(color->b);
+    c.a = ToByte(color->a);
+    return c;
+}
+
+void ResizeCanvas(Canvas* canvas, uint32_t width, uint32_t height,
+    const Color8& fill)
+{
+    canvas->width = width;
+    canvas->height = height;
+    canvas->rgba.resize((size_t)width * height * 4);
+
+    for (size_t i = 0; i < canvas->rgba.size(); i += 4)
+    {
+        canvas->rgba[i + 0] = fill.r;
+        canvas->rgba[i + 1] = fill.g;
+        canvas->rgba[i + 2] = fill.b;
+        canvas->rgba[i + 3] = fill.a;
+    }
+}
+
+bool CanvasFromImage(Canvas* canvas, RGBABitmapImage* image)
+{
+    if (!canvas || !image || image->x->empty())
+        return false;
+
+    canvas->width = (uint32_t)image->x->size();
+    canvas->height = (uint32_t)(*image->x)[0]->y->size();
+    canvas->rgba.resize((size_t)canvas->width * canvas->height * 4);
+
+    // pbPlots stores the image column by column, so walk it the same way and
+    // scatter into the row-major destination.
+    for (uint32_t x = 0; x < canvas->width; x++)
+    {
+        const std::vector<RGBA*>& column = *(*image->x)[x]->y;
+        uint8_t* dst = canvas->rgba.data() + (size_t)x * 4;
+
+        for (uint32_t y = 0; y < canvas->height; y++)
+        {
+            const RGBA* c = column[y];
+            dst[0] = ToByte(c->r);
+            dst[1] = ToByte(c->g);
+            dst[2] = ToByte(c->b);
+            dst[3] = ToByte(c->a);
+            dst += (size_t)canvas->width * 4;
+        }
+    }
+
+    return true;
+}
+
+CanvasClip CanvasRect(const Canvas& canvas)
+{
+    CanvasClip rect;
+    rect.x1 = (int)canvas.width - 1;
+    rect.y1 = (int)canvas.height - 1;
+    return rect;
+}
+
+void CanvasGrowRect(CanvasClip* rect, const CanvasClip& other)
+{
+    if (other.x1 < other.x0 || other.y1 < other.y0)
+        return;
+    if (rect->x1 < rect->x0 || rect->y1 < rect->y0)
+    {
+        *rect = other;
+        return;
+    }
+
+    rect->x0 = std::min(rect->x0, other.x0);
+    rect->y0 = std::min(rect->y0, other.y0);
+    rect->x1 = std::max(rect->x1, other.x1);
+    rect->y1 = std::max(rect->y1, other.y1);
+}
+
+void CanvasCopyRect(Canvas* dst, const Canvas& src, const CanvasClip& rect)
+{
+    const CanvasClip limits = Limits(&src, &rect);
+    if (limits.x1 < limits.x0)
+        return;
+
+    const size_t row = (size_t)src.width * 4;
+    const size_t span = (size_t)(limits.x1 - limits.x0 + 1) * 4;
+
+    for (int y = limits.y0; y <= limits.y1; y++)
+    {
+        const size_t at = y * row + (size_t)limits.x0 * 4;
+        std::memcpy(dst->rgba.data() + at, src.rgba.data() + at, span);
+    }
+}
+
+bool WriteCanvasPNG(const Canvas& canvas, const std::string& filename,
+    PngLevel level)
+{
+    if (canvas.rgba.empty())
+        return false;
+
+    return WritePNG(filename, canvas.rgba.data(), canvas.width, canvas.height,
+                    level);
+}
+
+bool WriteCanvasImage(const Canvas& canvas, const std::string& filename,
+    ImageFormat format, PngLevel level)
+{
+    if (canvas.rgba.empty())
+        return false;
+
+    return WriteImageFile(filename, canvas.rgba.data(), canvas.width,
+                          canvas.height, format, level);
+}
+
+void CanvasDrawPixel(Canvas* canvas, int x, int y, const Color8& color,
+    const CanvasClip* clip)
+{
+    PutPixel(canvas, Limits(canvas, clip), x, y, color);
+}
+
+void CanvasDrawLine(Canvas* canvas, int x0, int y0, int x1, int y1,
+    double thickness, const Color8& color, const CanvasClip* clip)
+{
+    const CanvasClip limits = Limits(canvas, clip);
+    const int size = BrushSize(thickness);
+    int first, last;
+
+    if (!StepsWithin(x0, y0, x1, y1, size, limits, &first, &last))
+        return;
+
+    if (size == 1)
+    {
+        Bresenham(x0, y0, x1, y1, first, last, [&](int x, int y) {
+            PutPixel(canvas, limits, x, y, color);
+        });
+    }
+    else
+    {
+        Bresenham(x0, y0, x1, y1, first, last, [&](int x, int y) {
+            DrawBrush(canvas, limits, x, y, size, color);
+        });
+    }
+}
+
+void CanvasDrawLinePatterned(Canvas* canvas, int x0, int y0, int x1, int y1,
+    double thickness, const std::vector<bool>& pattern, double* offset,
+    const Color8& color, const CanvasClip* clip)
+{
+    if (pattern.empty())
+    {
+        CanvasDrawLine(canvas, x0, y0, x1, y1, thickness, color, clip);
+        return;
+    }
+
+    // Same pattern walk as pbPlots: the offset advances one step per pixel
+    // and carries over to the next segment, each pattern entry spans
+    // `thickness` steps. Steps outside the clip are skipped in one go, like
+    // CanvasAdvancePattern does.
+    const CanvasClip limits = Limits(canvas, clip);
+    const int size = BrushSize(thickness);
+    const double period = pattern.size() * thickness;
+    const double end = CanvasAdvancePattern(x0, y0, x1, y1, thickness,
+                                            pattern, *offset);
+    int first, last;
+
+    if (StepsWithin(x0, y0, x1, y1, size, limits, &first, &last))
+    {
+        double step = std::fmod(*offset + first, period);
+        Bresenham(x0, y0, x1, y1, first, last, [&](int x, int y) {
+            step = std::fmod(step + 1.0, period);
+            if (pattern[(size_t)(step / thickness)])
+                DrawBrush(canvas, limits, x, y, size, color);
+        });
+    }
+    *offset = end;
+}
+
+double CanvasAdvancePattern(int x0, int y0, int x1, int y1, double thickness,
+    const std::vector<bool>& pattern, double offset)
+{
+    if (pattern.empty())
+        return offset;
+
+    // One fmod over all steps instead of one per step; the same value as long
+    // as the steps add up exactly, which they do for whole thicknesses.
+    const double period = pattern.size() * thickness;
+    return std::fmod(offset + BresenhamSteps(x0, y0, x1, y1), period);
+}
+
+void CanvasDrawCircle(Canvas* canvas, int x, int y, int radius,
+    const Color8& color, const CanvasClip* clip)
+{
+    const CanvasClip limits = Limits(canvas, clip);
+    int dx = radius;
+    int dy = 0;
+    int err = 1 - radius;
+
+    while (dx >= dy)
+    {
+        PutPixel(canvas, limits, x + dx, y + dy, color);
+        PutPixel(canvas, limits, x + dy, y + dx, color);
+        PutPixel(canvas, limits, x - dy, y + dx, color);
+        PutPixel(canvas, limits, x - dx, y + dy, color);
+        PutPixel(canvas, limits, x - dx, y - dy, color);
+        PutPixel(canvas, limits, x - dy, y - dx, color);
+        PutPixel(canvas, limits, x + dy, y - dx, color);
+        PutPixel(canvas, limits, x + dx, y - dy, color);
+
+        dy++;
+        if (err < 0)
+        {
+            err += 2 * dy + 1;
+        }
+        else
+        {
+            dx--;
+            err += 2 * (dy - dx) + 1;
+        }
+    }
+}
+
+void CanvasDrawFilledCircle(Canvas* canvas, int x, int y, int radius,
+    const Color8& color, const CanvasClip* clip)
+{
+    const CanvasClip limits = Limits(canvas, clip);
+
+    for (int dy = -radius; dy <= radius; dy++)
+    {
+        const int half = (int)std::sqrt((double)(radius * radius - dy * dy));
+        FillSpan(canvas, limits, x - half, x + half, y + dy, color);
+    }
+}
+
+void CanvasDrawTriangle(Canvas* canvas, int x, int y, int height,
+    const Color8& color, const CanvasClip* clip)
+{
+    int xs[3], ys[3];
+    TriangleCorners(x, y, height, xs, ys);
+
+    CanvasDrawLine(canvas, xs[0], ys[0], xs[1], ys[1], 1.0, color, clip);
+    CanvasDrawLine(canvas, xs[1], ys[1], xs[2], ys[2], 1.0, color, clip);
+    CanvasDrawLine(canvas, xs[2], ys[2], xs[0], ys[0], 1.0, color, clip);
+}
+
+void CanvasDrawFilledTriangle(Canvas* canvas, int x, int y, int height,
+    const Color8& color, const CanvasClip* clip)
+{
+    const CanvasClip limits = Limits(canvas, clip);
+    int xs[3], ys[3];
+    TriangleCorners(x, y, height, xs, ys);
+
+    // The triangle is symmetric around x with a flat bottom edge, so each row
+    // is a single span whose half width grows linearly from the apex.
+    const int rows = ys[1] - ys[0];
+    const int half_base = xs[1] - x;
+
+    for (int j = 0; j <= rows; j++)
+    {
+        const int half = rows > 0 ? half_base * j / rows : half_base;
+        FillSpan(canvas, limits, x - half, x + half, ys[0] + j, color);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "pbPlots.hpp"
+#include "image_file.h"
+#include "png.h"
+
+// Plot pixels packed as 8-bit RGBA, top row first - the layout expected by
+// glTexImage2D(GL_RGBA, GL_UNSIGNED_BYTE) and by the PNG writer. At 4 bytes
+// per pixel it is 8x smaller than pbPlots' RGBABitmapImage.
+struct Canvas
+{
+    uint32_t width=0;
+    uint32_t height=0;
+
+    std::vector<uint8_t> rgba;
+};
+
+struct Color8
+{
+    uint8_t r=0;
+    uint8_t g=0;
+    uint8_t b=0;
+    uint8_t a=255;
+};
+
+// Inclusive pixel rectangle that drawing can be restricted to, e.g. one
+// tile of the canvas, or that a drawing changed. Empty while x1 < x0, as
+// it is by default.
+struct CanvasClip
+{
+    int x0=0;
+    int y0=0;
+    int x1=-1;
+    int y1=-1;
+};
+
+Color8 ToColor8(const RGBA* color);
+
+void ResizeCanvas(Canvas* canvas, uint32_t width, uint32_t height,
+    const Color8& fill);
+bool CanvasFromImage(Canvas* canvas, RGBABitmapImage* image);
+
+// The whole canvas as a rectangle.
+CanvasClip CanvasRect(const Canvas& canvas);
+// Grows rect to cover other as well.
+void CanvasGrowRect(CanvasClip* rect, const CanvasClip& other);
+// Copies the pixels within rect from src into dst, which is src's size.
+void CanvasCopyRect(Canvas* dst, const Canvas& src, const CanvasClip& rect);
+bool WriteCanvasPNG(const Canvas& canvas, const std::string& filename,
+    PngLevel level = PngLevel::Fast);
+bool WriteCanvasImage(const Canvas& canvas, const std::string& filename,
+    ImageFormat format = ImageFormat::Auto, PngLevel level = PngLevel::Fast);
+
+// Drawing primitives. Coordinates are in pixels with the origin in the top
+// left corner; anything outside the canvas, or outside clip if one is given,
+// is clipped. A clipped shape puts down the same pixels as an unclipped one,
+// so drawing it once per clip rectangle gives the same pixels as drawing it
+// once without; lines only walk the stretch of their path inside the clip.
+void CanvasDrawPixel(Canvas* canvas, int x, int y, const Color8& color,
+    const CanvasClip* clip = nullptr);
+void CanvasDrawLine(Canvas* canvas, int x0, int y0, int x1, int y1,
+    double thickness, const Color8& color, const CanvasClip* clip = nullptr);
+void CanvasDrawLinePatterned(Canvas* canvas, int x0, int y0, int x1, int y1,
+    double thickness, const std::vector<bool>& pattern, double* offset,
+    const Color8& color, const CanvasClip* clip = nullptr);
+void CanvasDrawCircle(Canvas* canvas, int x, int y, int radius,
+    const Color8& color, const CanvasClip* clip = nullptr);
+void CanvasDrawFilledCircle(Canvas* canvas, int x, int y, int radius,
+    const Color8& color, const CanvasClip* clip = nullptr);
+void CanvasDrawTriangle(Canvas* canvas, int x, int y, int height,
+    const Color8& color, const CanvasClip* clip = nullptr);
+void CanvasDrawFilledTriangle(Canvas* canvas, int x, int y, int height,
+    const Color8& color, const CanvasClip* clip = nullptr);
+
+// Pattern offset CanvasDrawLinePatterned leaves behind after drawing the
+// line from (x0, y0) to (x1, y1) starting at offset.
+double CanvasAdvancePattern(int x0, int y0, int x1, int y1, double thickness,
+    const std::vector<bool>& pattern, double offset);
+
+#endif // CANVAS_H
@@ -0,0 +1,88 @@
+#include "clip.h"
+
+#include <algorithm>
+#include <cmath>
+
+PixelTransform MakePixelTransform(double xmin, double xmax, double ymin,
+    double ymax, double x_pixel_min, double x_pixel_max, double y_pixel_min,
+    double y_pixel_max)
+{
+    PixelTransform t;
+
+    t.x_scale = (x_pixel_max - x_pixel_min) / (xmax - xmin);
+    t.x_offset = x_pixel_min - xmin * t.x_scale;
+    t.y_scale = -(y_pixel_max - y_pixel_min) / (ymax - ymin);
+    t.y_offset = y_pixel_max - ymin * t.y_scale;
+
+    t.x_min = x_pixel_min;
+    t.x_max = x_pixel_max;
+    t.y_min = y_pixel_min;
+    t.y_max = y_pixel_max;
+
+    return t;
+}
+
+size_t ClipPolyline(const double* xs, const double* ys, size_t n,
+    const PixelTransform& transform, std::vector<double>* scratch,
+    std::vector<PixelSegment>* out)
+{
+    out->clear();
+    if (n < 2)
+        return 0;
+
+    scratch->resize(n * 2);
+    double* px = scratch->data();
+    double* py = px + n;
+
+    const double sx = transform.x_scale, ox = transform.x_offset;
+    const double sy = transform.y_scale, oy = transform.y_offset;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        px[i] = xs[i] * sx + ox;
+        py[i] = ys[i] * sy + oy;
+    }
+
+    const double x_min = transform.x_min, x_max = transform.x_max;
+    const double y_min = transform.y_min, y_max = transform.y_max;
+
+    out->resize(n - 1);
+    PixelSegment* segments = out->data();
+    size_t count = 0;
+
+    for (size_t i = 0; i + 1 < n; i++)
+    {
+        const double ax = px[i], ay = py[i];
+        const double bx = px[i + 1], by = py[i + 1];
+        const double dx = bx - ax, dy = by - ay;
+
+        // Liang-Barsky: each side of the rectangle narrows the parameter
+        // range [t0, t1] of the segment that lies inside it. A segment
+        // parallel to a side is either fully inside of it or rejected.
+        const double p[4] = { -dx, dx, -dy, dy };
+        const double q[4] = { ax - x_min, x_max - ax, ay - y_min, y_max - ay };
+        double t0 = 0.0, t1 = 1.0;
+        bool inside = std::isfinite(ax) && std::isfinite(ay)
+            && std::isfinite(dx) && std::isfinite(dy);
+
+        for (int k = 0; k < 4; k++)
+        {
+            const double r = q[k] / p[k];
+            inside = inside && (p[k] != 0.0 || q[k] >= 0.0);
+            t0 = p[k] < 0.0 ? std::max(t0, r) : t0;
+            t1 = p[k] > 0.0 ? std::min(t1, r) : t1;
+        }
+
+        if (!inside || t0 > t1)
+            continue;
+
+        PixelSegment& s = segments[count++];
+        s.x0 = (int)std::floor(t0 > 0.0 ? ax + t0 * dx : ax);
+        s.y0 = (int)std::floor(t0 > 0.0 ? ay + t0 * dy : ay);
+        s.x1 = (int)std::floor(t1 < 1.0 ? ax + t1 * dx : bx);
+        s.y1 = (int)std::floor(t1 < 1.0 ? ay + t1 * dy : by);
+    }
+
+    out->resize(count);
+    return count;
+}
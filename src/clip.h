@@ -0,0 +1,53 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include <cstddef>
+#include <vector>
+
+// Data to pixel mapping of a plot area, px = x * x_scale + x_offset and
+// py = y * y_scale + y_offset, with the plot area in pixels to clip to.
+struct PixelTransform
+{
+    double x_scale=1.0;
+    double x_offset=0.0;
+    double y_scale=1.0;
+    double y_offset=0.0;
+
+    double x_min=0.0;
+    double x_max=0.0;
+    double y_min=0.0;
+    double y_max=0.0;
+};
+
+// Segment end points in whole pixels.
+struct PixelSegment
+{
+    int x0, y0, x1, y1;
+};
+
+/**
+ * @brief Transform mapping [xmin, xmax] x [ymin, ymax] onto the pixel
+ * rectangle, with y growing downwards like pbPlots' MapYCoordinate.
+ */
+PixelTransform MakePixelTransform(double xmin, double xmax, double ymin,
+    double ymax, double x_pixel_min, double x_pixel_max, double y_pixel_min,
+    double y_pixel_max);
+
+/**
+ * @brief Geometry stage of line drawing for a whole polyline at once.
+ *
+ * All points are first mapped to pixel space in one pass, then every segment
+ * is clipped to the plot area with Liang-Barsky and floored to whole pixels.
+ * Segments that miss the plot area or have a non-finite end point are
+ * dropped, so out holds only segments that draw something, in polyline
+ * order. Both passes are plain loops over arrays that the compiler can
+ * vectorize.
+ *
+ * @param scratch Space for the transformed points, reused between calls.
+ * @return The number of segments written to out.
+ */
+size_t ClipPolyline(const double* xs, const double* ys, size_t n,
+    const PixelTransform& transform, std::vector<double>* scratch,
+    std::vector<PixelSegment>* out);
+
+#endif // CLIP_H
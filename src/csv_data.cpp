@@ -0,0 +1,205 @@
+#include "csv_data.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+// Chunks are made at least this large, so small files parse in one go.
+const size_t CSV_MIN_CHUNK = 1 << 20;
+
+inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// The whole of [begin, end), less white space and quotes, as a number.
+bool ParseNumber(const char* begin, const char* end, double* value)
+{
+    while (begin < end && IsBlank(*begin))
+        begin++;
+    while (end > begin && IsBlank(end[-1]))
+        end--;
+    if (end - begin >= 2 && *begin == '"' && end[-1] == '"')
+    {
+        begin++;
+        end--;
+    }
+    if (begin < end && *begin == '+')
+        begin++;
+    if (begin == end)
+        return false;
+
+    const std::from_chars_result r = std::from_chars(begin, end, *value);
+    return r.ec == std::errc() && r.ptr == end;
+}
+
+// Parses the lines of [p, end) into xs/ys, returns the number of points.
+size_t ParseChunk(const char* p, const char* end, char delimiter,
+    const CsvOptions& options, double* xs, double* ys)
+{
+    size_t count = 0;
+
+    while (p < end)
+    {
+        const void* nl = std::memchr(p, '\n', end - p);
+        const char* eol = nl ? (const char*)nl : end;
+
+        if (ParseCsvLine(p, eol, delimiter, options, xs + count, ys + count))
+            count++;
+        p = eol + 1;
+    }
+
+    return count;
+}
+
+}
+
+bool ParseCsvLine(const char* p, const char* end, char delimiter,
+    const CsvOptions& options, double* x, double* y)
+{
+    const size_t last = std::max(options.x_column, options.y_column);
+
+    for (size_t column = 0; column <= last; column++)
+    {
+        const char* field;
+
+        if (delimiter == ' ')
+        {
+            while (p < end && IsBlank(*p))
+                p++;
+            field = p;
+            while (p < end && !IsBlank(*p))
+                p++;
+        }
+        else
+        {
+            if (p > end)
+                return false;
+            field = p;
+            const void* at = std::memchr(p, delimiter, end - p);
+            p = at ? (const char*)at : end;
+        }
+
+        if (column == options.x_column && !ParseNumber(field, p, x))
+            return false;
+        if (column == options.y_column && !ParseNumber(field, p, y))
+            return false;
+
+        // past the delimiter; beyond end once the line is used up
+        if (delimiter != ' ')
+            p++;
+    }
+
+    return true;
+}
+
+char CsvDelimiter(const CsvOptions& options, const char* text, size_t size)
+{
+    if (options.delimiter)
+        return options.delimiter;
+
+    const void* nl = std::memchr(text, '\n', size);
+    const char* end = nl ? (const char*)nl : text + size;
+
+    for (char d : { '\t', ',', ';' })
+    {
+        if (std::find(text, end, d) != end)
+            return d;
+    }
+    return ' ';
+}
+
+bool LoadCsvData(const std::string& filename, const CsvOptions& options,
+    std::vector<double>* xs, std::vector<double>* ys,
+    const CsvProgress& progress, std::string* error)
+{
+    xs->clear();
+    ys->clear();
+
+    MappedFile file;
+    if (!MapFile(&file, filename, error))
+        return false;
+
+    const char* text = (const char*)file.data;
+    const size_t size = file.size;
+    const char delimiter = CsvDelimiter(options, text, size);
+
+    // chunk starts, each one at the beginning of a line
+    const size_t target = std::max(CSV_MIN_CHUNK,
+                                   size / (size_t(ParallelWorkers()) * 8) + 1);
+    std::vector<size_t> starts(1, 0);
+    while (starts.back() < size)
+    {
+        size_t next = starts.back() + target;
+        if (next >= size)
+        {
+            next = size;
+        }
+        else
+        {
+            const void* nl = std::memchr(text + next, '\n', size - next);
+            next = nl ? (const char*)nl - text + 1 : size;
+        }
+        starts.push_back(next);
+    }
+    const size_t chunks = starts.size() - 1;
+
+    // Every chunk gets room for as many points as it has lines, parses into
+    // that room and the stretches are closed up afterwards.
+    std::vector<size_t> offsets(chunks + 1, 0);
+    std::vector<size_t> filled(chunks, 0);
+
+    ParallelFor(0, chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++)
+        {
+            offsets[c + 1] = std::count(text + starts[c], text + starts[c + 1],
+                                        '\n') + 1;
+        }
+    });
+    for (size_t c = 0; c < chunks; c++)
+        offsets[c + 1] += offsets[c];
+
+    xs->resize(offsets[chunks]);
+    ys->resize(offsets[chunks]);
+
+    std::mutex progress_mutex;
+    size_t done = 0;
+
+    ParallelFor(0, chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++)
+        {
+            filled[c] = ParseChunk(text + starts[c], text + starts[c + 1],
+                                   delimiter, options, xs->data() + offsets[c],
+                                   ys->data() + offsets[c]);
+            if (progress)
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                done += starts[c + 1] - starts[c];
+                progress(done, size);
+            }
+        }
+    });
+
+    size_t count = 0;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        if (offsets[c] != count)
+        {
+            std::copy_n(xs->begin() + offsets[c], filled[c],
+                        xs->begin() + count);
+            std::copy_n(ys->begin() + offsets[c], filled[c],
+                        ys->begin() + count);
+        }
+        count += filled[c];
+    }
+    xs->resize(count);
+    ys->resize(count);
+
+    UnmapFile(&file);
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef CSV_DATA_H
+#define CSV_DATA_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct CsvOptions
+{
+    // field separator; 0 picks tab, comma or semicolon, whichever the first
+    // line has, else runs of spaces and tabs, which ' ' picks as well
+    char delimiter=0;
+
+    // zero based columns of the x and y values
+    size_t x_column=0;
+    size_t y_column=1;
+};
+
+// Bytes of the file parsed so far out of its size. Called from the worker
+// threads, one call at a time.
+typedef std::function<void(size_t done, size_t total)> CsvProgress;
+
+/**
+ * @brief Reads two columns of a CSV/TSV file into xs/ys.
+ *
+ * The file is memory mapped and cut into chunks at line ends, which are
+ * parsed with std::from_chars on the worker pool, each straight into its
+ * own stretch of xs/ys. Lines whose x or y field is not a number (headers,
+ * comments, gaps) are skipped. Fields may be quoted, white space around
+ * them is ignored.
+ *
+ * @return false with a message in error if the file cannot be read.
+ */
+bool LoadCsvData(const std::string& filename, const CsvOptions& options,
+    std::vector<double>* xs, std::vector<double>* ys,
+    const CsvProgress& progress, std::string* error);
+
+// The delimiter options.delimiter stands for in a file starting with text.
+char CsvDelimiter(const CsvOptions& options, const char* text, size_t size);
+
+// Reads the x and y columns of the line [begin, end), without its '\n';
+// false if either is not a number.
+bool ParseCsvLine(const char* begin, const char* end, char delimiter,
+    const CsvOptions& options, double* x, double* y);
+
+#endif // CSV_DATA_H
@@ -0,0 +1,294 @@
+#include "decimate.h"
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+struct Run
+{
+    size_t first, last, lowest, highest;
+};
+
+// Values stride elements apart, e.g. one column of interleaved x, y pairs.
+struct Strided
+{
+    const double* data;
+    size_t stride;
+
+    double operator[](size_t i) const { return data[i * stride]; }
+};
+
+// Index of the lower/higher of two points by y; NaN never wins.
+inline size_t Lower(Strided ys, size_t a, size_t b)
+{
+    if (std::isnan(ys[a]))
+        return b;
+    return ys[b] < ys[a] ? b : a;
+}
+
+inline size_t Higher(Strided ys, size_t a, size_t b)
+{
+    if (std::isnan(ys[a]))
+        return b;
+    return ys[b] > ys[a] ? b : a;
+}
+
+MinMaxEntry Merge(Strided ys, const MinMaxEntry& a, const MinMaxEntry& b)
+{
+    return { Lower(ys, a.lowest, b.lowest), Higher(ys, a.highest, b.highest) };
+}
+
+MinMaxEntry ScanRange(Strided ys, size_t begin, size_t end)
+{
+    MinMaxEntry e = { begin, begin };
+    for (size_t i = begin + 1; i < end; i++)
+    {
+        e.lowest = Lower(ys, e.lowest, i);
+        e.highest = Higher(ys, e.highest, i);
+    }
+    return e;
+}
+
+// Lowest and highest point in [begin, end), which must not be empty: raw
+// points for the ragged ends, pyramid entries for the aligned middle.
+MinMaxEntry RangeMinMax(const MinMaxPyramid& p, size_t begin, size_t end)
+{
+    const Strided ys = { p.ys, p.stride };
+    const size_t blocks = p.levels[0].size();
+    size_t b0 = (begin + PYRAMID_BLOCK - 1) / PYRAMID_BLOCK;
+    size_t b1 = end == p.count ? blocks : end / PYRAMID_BLOCK;
+
+    if (b0 >= b1)
+        return ScanRange(ys, begin, end);
+
+    MinMaxEntry e = p.levels[0][b0];
+    if (begin < b0 * PYRAMID_BLOCK)
+        e = Merge(ys, e, ScanRange(ys, begin, b0 * PYRAMID_BLOCK));
+    if (b1 * PYRAMID_BLOCK < end)
+        e = Merge(ys, e, ScanRange(ys, b1 * PYRAMID_BLOCK, end));
+
+    // Bottom-up walk, taking the odd entries at either end of each level.
+    for (size_t level = 0; b0 < b1; level++, b0 >>= 1, b1 >>= 1)
+    {
+        const std::vector<MinMaxEntry>& entries = p.levels[level];
+        if (b0 & 1)
+            e = Merge(ys, e, entries[b0++]);
+        if (b1 & 1)
+            e = Merge(ys, e, entries[--b1]);
+    }
+
+    return e;
+}
+
+// First index in [0, n) for which below(i) is false; below must be true for
+// a prefix of the range, like for std::partition_point.
+template <typename Below>
+size_t PartitionPoint(size_t n, Below below)
+{
+    size_t first = 0;
+    while (n > 0)
+    {
+        const size_t half = n / 2;
+        if (below(first + half))
+        {
+            first += half + 1;
+            n -= half + 1;
+        }
+        else
+        {
+            n = half;
+        }
+    }
+    return first;
+}
+
+void EmitPoint(Strided xs, Strided ys, size_t i,
+    std::vector<double>* out_xs, std::vector<double>* out_ys)
+{
+    out_xs->push_back(xs[i]);
+    out_ys->push_back(ys[i]);
+}
+
+void EmitRun(const Run& run, Strided xs, Strided ys,
+    std::vector<double>* out_xs, std::vector<double>* out_ys)
+{
+    size_t picks[4] = { run.first, run.lowest, run.highest, run.last };
+    if (picks[1] > picks[2])
+        std::swap(picks[1], picks[2]);
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (i > 0 && picks[i] == picks[i - 1])
+            continue;
+        out_xs->push_back(xs[picks[i]]);
+        out_ys->push_back(ys[picks[i]]);
+    }
+}
+
+}
+
+size_t DecimateM4(const double* xs, const double* ys, size_t n, double x_scale,
+    double x_offset, std::vector<double>* out_xs, std::vector<double>* out_ys)
+{
+    out_xs->clear();
+    out_ys->clear();
+
+    if (n == 0)
+        return 0;
+
+    const Strided sxs = { xs, 1 };
+    const Strided sys = { ys, 1 };
+    Run run = { 0, 0, 0, 0 };
+    double column = NAN;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const double x = xs[i];
+        const double y = ys[i];
+
+        if (!std::isfinite(x) || !std::isfinite(y))
+        {
+            if (!std::isnan(column))
+                EmitRun(run, sxs, sys, out_xs, out_ys);
+            out_xs->push_back(x);
+            out_ys->push_back(y);
+            column = NAN;
+            continue;
+        }
+
+        const double c = std::floor(x * x_scale + x_offset);
+
+        if (c == column)
+        {
+            run.last = i;
+            if (y < ys[run.lowest])
+                run.lowest = i;
+            if (y > ys[run.highest])
+                run.highest = i;
+        }
+        else
+        {
+            if (!std::isnan(column))
+                EmitRun(run, sxs, sys, out_xs, out_ys);
+            run = { i, i, i, i };
+            column = c;
+        }
+    }
+
+    if (!std::isnan(column))
+        EmitRun(run, sxs, sys, out_xs, out_ys);
+
+    return out_xs->size();
+}
+
+bool BuildMinMaxPyramid(MinMaxPyramid* pyramid, const double* xs,
+    const double* ys, size_t count, size_t stride)
+{
+    const Strided sxs = { xs, stride };
+    const Strided sys = { ys, stride };
+
+    pyramid->xs = nullptr;
+    pyramid->ys = nullptr;
+    pyramid->count = 0;
+    pyramid->levels.clear();
+
+    if (count == 0)
+        return false;
+
+    const size_t blocks = (count + PYRAMID_BLOCK - 1) / PYRAMID_BLOCK;
+    std::vector<MinMaxEntry> bottom(blocks);
+    std::atomic<bool> sorted{ true };
+
+    ParallelFor(0, blocks, 1024, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++)
+        {
+            const size_t i0 = b * PYRAMID_BLOCK;
+            const size_t i1 = std::min(count, i0 + PYRAMID_BLOCK);
+
+            // each block also checks the step into it from the previous one
+            for (size_t i = std::max<size_t>(i0, 1); i < i1; i++)
+            {
+                if (!(sxs[i - 1] <= sxs[i]))
+                    sorted = false;
+            }
+            bottom[b] = ScanRange(sys, i0, i1);
+        }
+    });
+
+    if (!sorted)
+        return false;
+
+    pyramid->levels.push_back(std::move(bottom));
+    while (pyramid->levels.back().size() > 1)
+    {
+        const std::vector<MinMaxEntry>& below = pyramid->levels.back();
+        std::vector<MinMaxEntry> level((below.size() + 1) / 2);
+
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            level[i] = 2 * i + 1 < below.size()
+                ? Merge(sys, below[2 * i], below[2 * i + 1])
+                : below[2 * i];
+        }
+        pyramid->levels.push_back(std::move(level));
+    }
+
+    pyramid->xs = xs;
+    pyramid->ys = ys;
+    pyramid->stride = stride;
+    pyramid->count = count;
+    return true;
+}
+
+size_t DecimateRange(const MinMaxPyramid& pyramid, double xmin, double xmax,
+    uint32_t columns, std::vector<double>* out_xs,
+    std::vector<double>* out_ys)
+{
+    out_xs->clear();
+    out_ys->clear();
+
+    if (pyramid.count == 0 || columns == 0 || !(xmax > xmin))
+        return 0;
+
+    const Strided xs = { pyramid.xs, pyramid.stride };
+    const Strided ys = { pyramid.ys, pyramid.stride };
+    const double width = (xmax - xmin) / columns;
+
+    // Column c spans [bounds[c], bounds[c + 1]); the last one includes xmax.
+    std::vector<size_t> bounds(columns + 1);
+    for (uint32_t c = 0; c < columns; c++)
+    {
+        const double x = xmin + width * c;
+        bounds[c] = PartitionPoint(pyramid.count,
+                                   [&](size_t i) { return xs[i] < x; });
+    }
+    bounds[columns] = PartitionPoint(pyramid.count,
+                                     [&](size_t i) { return xs[i] <= xmax; });
+
+    out_xs->reserve(size_t(columns) * 4 + 2);
+    out_ys->reserve(size_t(columns) * 4 + 2);
+
+    if (bounds[0] > 0)
+        EmitPoint(xs, ys, bounds[0] - 1, out_xs, out_ys);
+
+    for (uint32_t c = 0; c < columns; c++)
+    {
+        const size_t i0 = bounds[c];
+        const size_t i1 = std::max(i0, bounds[c + 1]);
+        if (i0 == i1)
+            continue;
+
+        const MinMaxEntry e = RangeMinMax(pyramid, i0, i1);
+        EmitRun({ i0, i1 - 1, e.lowest, e.highest }, xs, ys, out_xs, out_ys);
+    }
+
+    if (bounds[columns] < pyramid.count)
+        EmitPoint(xs, ys, bounds[columns], out_xs, out_ys);
+
+    return out_xs->size();
+}
@@ -0,0 +1,74 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Series with fewer points than this per pixel column are drawn as they are.
+const double DECIMATION_POINTS_PER_COLUMN = 4.0;
+
+/**
+ * @brief M4 decimation of a polyline for rasterization.
+ *
+ * Consecutive points that fall into the same pixel column, with the column
+ * given by floor(x * x_scale + x_offset), are replaced by the first, the
+ * lowest, the highest and the last of them, in their original order. The
+ * polyline through those covers the same pixels in that column and connects
+ * to its neighbours the same way, so a solid line renders the same. A dash
+ * pattern advances along the pixels of the path drawn, which is shorter
+ * now, so the dashes of a patterned line shift.
+ * Only runs of consecutive points are merged, so xs need not be sorted;
+ * non-finite points are kept as they are.
+ *
+ * @return The number of points written to out_xs/out_ys.
+ */
+size_t DecimateM4(const double* xs, const double* ys, size_t n, double x_scale,
+    double x_offset, std::vector<double>* out_xs, std::vector<double>* out_ys);
+
+// Points per block at the bottom level of a MinMaxPyramid.
+const size_t PYRAMID_BLOCK = 64;
+
+struct MinMaxEntry
+{
+    size_t lowest;
+    size_t highest;
+};
+
+// Level of detail summary of a series sorted by x. The series itself is
+// referenced, not copied, and must outlive the pyramid. Point i is
+// (xs[i * stride], ys[i * stride]), so interleaved x, y pairs can be
+// referenced with ys = xs + 1 and a stride of 2.
+struct MinMaxPyramid
+{
+    const double* xs=nullptr;
+    const double* ys=nullptr;
+    size_t stride=1;
+    size_t count=0;
+
+    // levels[0] holds the indices of the lowest and highest y of every block
+    // of PYRAMID_BLOCK points, every further level merges pairs of entries
+    // of the level below, up to a single entry for the whole series.
+    std::vector<std::vector<MinMaxEntry>> levels;
+};
+
+/**
+ * @brief Builds the pyramid over xs/ys in O(n), spread over the worker pool.
+ * @return false if xs is not sorted, the pyramid is left empty then.
+ */
+bool BuildMinMaxPyramid(MinMaxPyramid* pyramid, const double* xs,
+    const double* ys, size_t count, size_t stride = 1);
+
+/**
+ * @brief M4 decimation of the part of the series within [xmin, xmax] into
+ * the given number of equally wide columns, read from the pyramid in
+ * O(columns * log n). The points just outside the range are included too,
+ * so lines run on to the edges of the plot.
+ *
+ * @return The number of points written to out_xs/out_ys.
+ */
+size_t DecimateRange(const MinMaxPyramid& pyramid, double xmin, double xmax,
+    uint32_t columns, std::vector<double>* out_xs,
+    std::vector<double>* out_ys);
+
+#endif // DECIMATE_H
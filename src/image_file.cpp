@@ -0,0 +1,279 @@
+#include "image_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+bool WriteFile(const std::string& filename, const uint8_t* header,
+    size_t header_size, const uint8_t* data, size_t size)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file.write((const char*)header, (std::streamsize)header_size);
+    file.write((const char*)data, (std::streamsize)size);
+    return (bool)file;
+}
+
+void PutU32LE(uint8_t* dst, uint32_t v)
+{
+    dst[0] = (uint8_t)v;
+    dst[1] = (uint8_t)(v >> 8);
+    dst[2] = (uint8_t)(v >> 16);
+    dst[3] = (uint8_t)(v >> 24);
+}
+
+void PutU32BE(uint8_t* dst, uint32_t v)
+{
+    dst[0] = (uint8_t)(v >> 24);
+    dst[1] = (uint8_t)(v >> 16);
+    dst[2] = (uint8_t)(v >> 8);
+    dst[3] = (uint8_t)v;
+}
+
+std::string RawHeader(uint32_t width, uint32_t height)
+{
+    uint8_t header[12] = { 'R', 'G', 'B', 'A' };
+    PutU32LE(header + 4, width);
+    PutU32LE(header + 8, height);
+    return std::string((const char*)header, sizeof(header));
+}
+
+std::string PpmHeader(uint32_t width, uint32_t height)
+{
+    return "P6\n" + std::to_string(width) + " " + std::to_string(height)
+        + "\n255\n";
+}
+
+void DropAlpha(const uint8_t* rgba, size_t pixels, uint8_t* rgb)
+{
+    for (size_t i = 0; i < pixels; i++)
+    {
+        rgb[i * 3 + 0] = rgba[i * 4 + 0];
+        rgb[i * 3 + 1] = rgba[i * 4 + 1];
+        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+}
+
+bool WriteRaw(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height)
+{
+    const std::string header = RawHeader(width, height);
+
+    return WriteFile(filename, (const uint8_t*)header.data(), header.size(),
+                     rgba, (size_t)width * height * 4);
+}
+
+bool WritePpm(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height)
+{
+    const std::string header = PpmHeader(width, height);
+    const size_t pixels = (size_t)width * height;
+    std::vector<uint8_t> rgb(pixels * 3);
+    DropAlpha(rgba, pixels, rgb.data());
+
+    return WriteFile(filename, (const uint8_t*)header.data(), header.size(),
+                     rgb.data(), rgb.size());
+}
+
+// Rewrites rows y0 to y1 of a raw (channels 4) or PPM (channels 3) file in
+// place; false if the file does not start with the expected header.
+bool PatchRows(const std::string& filename, const std::string& header,
+    int channels, const uint8_t* rgba, uint32_t width, uint32_t y0,
+    uint32_t y1)
+{
+    std::fstream file(filename, std::ios::in | std::ios::out
+                                    | std::ios::binary);
+    std::string found(header.size(), '\0');
+    if (!file.read(&found[0], (std::streamsize)found.size())
+        || found != header)
+        return false;
+
+    const size_t pixels = (size_t)width * (y1 - y0 + 1);
+    const uint8_t* src = rgba + (size_t)y0 * width * 4;
+    std::vector<uint8_t> rgb;
+    if (channels == 3)
+    {
+        rgb.resize(pixels * 3);
+        DropAlpha(src, pixels, rgb.data());
+        src = rgb.data();
+    }
+
+    file.seekp((std::streamoff)(header.size()
+                                + (size_t)y0 * width * channels));
+    file.write((const char*)src, (std::streamsize)(pixels * channels));
+    return (bool)file;
+}
+
+// QOI encoder following the specification at qoiformat.org.
+bool WriteQoi(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height)
+{
+    const uint8_t OP_INDEX = 0x00, OP_DIFF = 0x40, OP_LUMA = 0x80,
+                  OP_RUN = 0xC0, OP_RGB = 0xFE, OP_RGBA = 0xFF;
+    const size_t pixels = (size_t)width * height;
+
+    uint8_t header[14] = { 'q', 'o', 'i', 'f' };
+    PutU32BE(header + 4, width);
+    PutU32BE(header + 8, height);
+    header[12] = 4; // RGBA
+    header[13] = 0; // sRGB with linear alpha
+
+    // worst case is OP_RGBA for every pixel, plus the end marker
+    std::vector<uint8_t> out(pixels * 5 + 8);
+    uint8_t* p = out.data();
+
+    uint8_t index[64][4];
+    std::memset(index, 0, sizeof(index));
+    uint8_t prev[4] = { 0, 0, 0, 255 };
+    int run = 0;
+
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const uint8_t* px = rgba + i * 4;
+
+        if (std::memcmp(px, prev, 4) == 0)
+        {
+            run++;
+            if (run == 62 || i + 1 == pixels)
+            {
+                *p++ = (uint8_t)(OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0)
+        {
+            *p++ = (uint8_t)(OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        const int slot = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+
+        if (std::memcmp(index[slot], px, 4) == 0)
+        {
+            *p++ = (uint8_t)(OP_INDEX | slot);
+        }
+        else
+        {
+            std::memcpy(index[slot], px, 4);
+
+            if (px[3] == prev[3])
+            {
+                const int dr = (int8_t)(px[0] - prev[0]);
+                const int dg = (int8_t)(px[1] - prev[1]);
+                const int db = (int8_t)(px[2] - prev[2]);
+                const int dr_dg = dr - dg;
+                const int db_dg = db - dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2
+                    && db <= 1)
+                {
+                    *p++ = (uint8_t)(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2
+                                     | (db + 2));
+                }
+                else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7
+                         && db_dg >= -8 && db_dg <= 7)
+                {
+                    *p++ = (uint8_t)(OP_LUMA | (dg + 32));
+                    *p++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+                }
+                else
+                {
+                    *p++ = OP_RGB;
+                    *p++ = px[0];
+                    *p++ = px[1];
+                    *p++ = px[2];
+                }
+            }
+            else
+            {
+                *p++ = OP_RGBA;
+                std::memcpy(p, px, 4);
+                p += 4;
+            }
+        }
+
+        std::memcpy(prev, px, 4);
+    }
+
+    static const uint8_t end_marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    std::memcpy(p, end_marker, sizeof(end_marker));
+    p += sizeof(end_marker);
+
+    return WriteFile(filename, header, sizeof(header), out.data(),
+                     (size_t)(p - out.data()));
+}
+
+}
+
+ImageFormat ImageFormatFromFilename(const std::string& filename)
+{
+    const size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos)
+        return ImageFormat::Png;
+
+    std::string ext = filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+
+    if (ext == "raw" || ext == "rgba")
+        return ImageFormat::Raw;
+    if (ext == "ppm")
+        return ImageFormat::Ppm;
+    if (ext == "qoi")
+        return ImageFormat::Qoi;
+    return ImageFormat::Png;
+}
+
+bool WriteImageFile(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height, ImageFormat format, PngLevel png_level)
+{
+    if (!rgba || width == 0 || height == 0)
+        return false;
+
+    if (format == ImageFormat::Auto)
+        format = ImageFormatFromFilename(filename);
+
+    switch (format)
+    {
+    case ImageFormat::Raw:
+        return WriteRaw(filename, rgba, width, height);
+    case ImageFormat::Ppm:
+        return WritePpm(filename, rgba, width, height);
+    case ImageFormat::Qoi:
+        return WriteQoi(filename, rgba, width, height);
+    default:
+        return WritePNG(filename, rgba, width, height, png_level);
+    }
+}
+
+bool UpdateImageFile(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height, uint32_t y0, uint32_t y1,
+    ImageFormat format, PngLevel png_level)
+{
+    if (!rgba || width == 0 || height == 0)
+        return false;
+
+    if (format == ImageFormat::Auto)
+        format = ImageFormatFromFilename(filename);
+
+    if (y1 >= height)
+        y1 = height - 1;
+    if (y0 > y1)
+        return true;
+
+    if (format == ImageFormat::Raw
+        && PatchRows(filename, RawHeader(width, height), 4, rgba, width, y0,
+                     y1))
+        return true;
+    if (format == ImageFormat::Ppm
+        && PatchRows(filename, PpmHeader(width, height), 3, rgba, width, y0,
+                     y1))
+        return true;
+
+    return WriteImageFile(filename, rgba, width, height, format, png_level);
+}
@@ -0,0 +1,49 @@
+#ifndef IMAGE_FILE_H
+#define IMAGE_FILE_H
+
+#include <cstdint>
+#include <string>
+#include "png.h"
+
+enum class ImageFormat
+{
+    // picked from the file extension, PNG if it is not one of the others
+    Auto,
+    Png,
+    // "RGBA", width and height as little endian uint32, then the pixels
+    // as they are in memory
+    Raw,
+    // binary PPM (P6); the alpha channel is dropped
+    Ppm,
+    // Quite OK Image format, lossless and about as cheap as a copy
+    Qoi,
+};
+
+/**
+ * @brief The format a file name asks for: .png, .raw or .rgba, .ppm, .qoi,
+ * ignoring case. Anything else is PNG.
+ */
+ImageFormat ImageFormatFromFilename(const std::string& filename);
+
+/**
+ * @brief Writes an 8-bit RGBA image, rows top to bottom, in the given
+ * format. Raw, PPM and QOI cost little more than writing the pixels, for
+ * frames that are post-processed or fed to a video encoder; png_level only
+ * applies to PNG.
+ */
+bool WriteImageFile(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height, ImageFormat format = ImageFormat::Auto,
+    PngLevel png_level = PngLevel::Fast);
+
+/**
+ * @brief Brings a file written by WriteImageFile up to date after rows y0
+ * to y1 of the image changed. Raw and PPM files are patched in place, only
+ * those rows are written; other formats, or a file that does not have the
+ * size of the image, are written anew.
+ */
+bool UpdateImageFile(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height, uint32_t y0, uint32_t y1,
+    ImageFormat format = ImageFormat::Auto,
+    PngLevel png_level = PngLevel::Fast);
+
+#endif // IMAGE_FILE_H
@@ -1,21 +1,29 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <vector>
 #include <string>
 #include <utility>
 
 #include "CLI/CLI.hpp"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 #include "plotter.h"
 #include "overlay.h"
+#include "shader.h"
+#include "thread_pool.h"
+#include "batch.h"
+#include "series_tiles.h"
+#include "binary_data.h"
+#include "csv_data.h"
+#include "sample_stream.h"
 
 /////////////////////////////////////////////////////////////////////////
 
-PlotData plot_data;
+thread_local PlotData plot_data;
 
 /////////////////////////////////////////////////////////////////////////
 
@@ -26,7 +34,7 @@ const char* vertexShaderSource = R"(
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 out vec2 TexCoord;
-uniform mat4 projection;
+layout (std140) uniform Projection { mat4 projection; };
 void main()
 {
     gl_Position = projection * vec4(aPos, 1.0);
@@ -47,7 +55,7 @@ void main()
 const char* vertexOvlSource = R"(
 #version 330 core
 layout (location = 0) in vec3 aPos;
-uniform mat4 projection;
+layout (std140) uniform Projection { mat4 projection; };
 void main()
 {
     gl_Position = projection * vec4(aPos, 1.0);
@@ -63,18 +71,103 @@ void main()
 }
 )";
 
+// Projection of the plot quad, the tiles, the series and the overlays,
+// shared by both shader programs.
+ProjectionBuffer projection_;
+
 int texture_width_ = 0;
 int texture_height_ = 0;
 unsigned int texture_id_;
 
+// The plot texture is filled from these pixel buffers in turn, so writing
+// the pixels of one upload does not wait for the driver to finish reading
+// those of the last. Each one holds a whole plot.
+unsigned int texture_pbos_[2] = { 0, 0 };
+int texture_pbo_next_ = 0;
+
+// glTexStorage2D, where the driver has it (GL 4.2 or ARB_texture_storage);
+// the loader only covers GL 3.0. Immutable storage is made anew for every
+// plot size, else it is allocated with glTexImage2D once per size.
+typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels,
+                                          GLenum format, GLsizei width,
+                                          GLsizei height);
+TexStorage2DProc tex_storage_2d_ = nullptr;
+
 std::unique_ptr<RenderObject> points_;
 std::unique_ptr<RenderObject> lines_x_;
 std::unique_ptr<RenderObject> lines_y_;
 
+// Vertex buffers of the recorded plot series (--gpu-series), one per series;
+// unused ones are kept empty for the next plot.
+std::vector<std::unique_ptr<RenderObject>> series_;
+
+// Draw the recorded series from raster tiles (--tiles) instead.
+bool tiled_series_ = false;
+
+// Uploaded tiles of the current series version, least recently drawn ones
+// are dropped beyond TILE_CACHE_SIZE.
+struct TileTexture
+{
+    unsigned int texture = 0;
+    uint64_t used = 0;
+};
+const size_t TILE_CACHE_SIZE = 256;
+std::map<TileKey, TileTexture> tile_textures_;
+uint64_t tile_frame_ = 0;
+
+// Pan and zoom of the recorded series, reset by every new plot. The frame
+// follows once the view has not changed for VIEW_SETTLE_SECONDS.
+const double VIEW_SETTLE_SECONDS = 0.15;
+PlotView view_;
+uint64_t view_version_ = 0;
+bool frame_stale_ = false;
+double view_changed_at_ = 0.0;
+
+bool dragging_ = false;
+double drag_x_ = 0.0;
+double drag_y_ = 0.0;
+
+// The window is only redrawn when redraw_ is set, by the callbacks and
+// uploads that change what it shows, and otherwise waits for events;
+// --continuous redraws every frame. Frames are at least frame_interval_
+// seconds apart (--max-fps), 0 for no limit.
+bool continuous_ = false;
+bool redraw_ = true;
+double frame_interval_ = 0.0;
+double frame_drawn_at_ = 0.0;
+
+// How long to wait for events while something else may change the window:
+// samples arriving on the stream, tiles rendered in the background.
+const double POLL_SECONDS = 1.0 / 60.0;
+bool tiles_missing_ = false;
+
 int key_pressed_ = 0;
 
 const std::string plot_filename_ = "plot.png";
 
+// When set, every generated plot is also exported to this PNG file.
+std::string export_filename_;
+
+// Sample functions adaptively instead of on a fixed uniform grid.
+bool adaptive_sampling_ = false;
+
+// Level of detail summary of the loaded data set, empty when none is loaded.
+// Range selections with 'x'/'y' replot it without touching the full data.
+MinMaxPyramid data_pyramid_;
+
+// Binary data file (--data) the pyramid refers to, mapped for the whole run.
+BinaryData data_file_;
+
+// Columns of the text data file (--csv) the pyramid refers to.
+std::vector<double> csv_xs_;
+std::vector<double> csv_ys_;
+
+// Live plot of a sample stream (--stream), until the stream ends; the
+// samples taken from it each frame.
+bool streaming_ = false;
+std::vector<double> stream_xs_;
+std::vector<double> stream_ys_;
+
 } // end of anonymous namespace
 
 /////////////////////////////////////////////////////////////////////////
@@ -85,7 +178,15 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action,
 void mouse_button_callback(GLFWwindow* window, int button, int action,
                            int mods);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
-void reloadTexture(GLFWwindow* window, const std::string& filename);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void window_refresh_callback(GLFWwindow* window);
+void wait_for_changes();
+void uploadTexture(GLFWwindow* window, const Canvas& canvas);
+void updateTexture(const Canvas& canvas);
+void uploadDirtyRect(const Canvas& canvas);
+void createPlotTexture();
+void allocatePlotTexture(int width, int height);
+void uploadSeries();
 
 /////////////////////////////////////////////////////////////////////////
 
@@ -122,6 +223,217 @@ Vertex plot_to_ortho_coords(const Vertex & v)
     return pixel_to_ortho_coords(w);
 }
 
+// Projection of the recorded series, whose points are relative to the
+// origin of plot_series, onto the plot image in ortho coords, as panned and
+// zoomed by view_.
+void series_projection(float projection[4][4])
+{
+    const PixelTransform& t = plot_series.transform;
+    const double w = plot_series.width;
+    const double h = plot_series.height;
+
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            projection[i][j] = i == j ? 1.f : 0.f;
+
+    projection[0][0] = float(2.0 * t.x_scale * view_.zoom / w);
+    projection[1][1] = float(-2.0 * t.y_scale * view_.zoom / h);
+    projection[3][0] = float(2.0 * view_.x / w - 1.0);
+    projection[3][1] = float(1.0 - 2.0 * view_.y / h);
+}
+
+// Limits drawing to the part of the image pixel rectangle [x0, x1] x [y0, y1]
+// inside the plot area, with the image shown in viewport (x, y, w, h).
+void image_scissor(double x0, double y0, double x1, double y1,
+                   const int viewport[4])
+{
+    const PixelTransform& t = plot_series.transform;
+    const double sx = double(viewport[2]) / plot_series.width;
+    const double sy = double(viewport[3]) / plot_series.height;
+
+    x0 = std::max(x0, t.x_min);
+    y0 = std::max(y0, t.y_min);
+    x1 = std::min(x1, t.x_max);
+    y1 = std::min(y1, t.y_max);
+
+    int left = viewport[0] + int(x0 * sx + 0.5);
+    int right = viewport[0] + int(x1 * sx + 0.5);
+    int bottom = viewport[1] + int((plot_series.height - y1) * sy + 0.5);
+    int top = viewport[1] + int((plot_series.height - y0) * sy + 0.5);
+    glScissor(left, bottom, std::max(right - left, 0),
+              std::max(top - bottom, 0));
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Pan and zoom of recorded series (--gpu-series, --tiles)
+
+bool view_enabled()
+{
+    return plot_data.gpu_series && plot_series.width > 0;
+}
+
+void view_changed()
+{
+    double xmin, xmax, ymin, ymax;
+    ViewRange(plot_series, view_, &xmin, &xmax, &ymin, &ymax);
+
+    // clicks map to the new range right away, the axes follow later
+    plot_data.range_x_min = xmin;
+    plot_data.range_x_max = xmax;
+    plot_data.range_y_min = ymin;
+    plot_data.range_y_max = ymax;
+
+    frame_stale_ = true;
+    view_changed_at_ = glfwGetTime();
+    redraw_ = true;
+}
+
+void redraw_view_frame(GLFWwindow* window)
+{
+    frame_stale_ = false;
+
+    if (!RedrawPlotFrame(plot_data.range_x_min, plot_data.range_x_max,
+                         plot_data.range_y_min, plot_data.range_y_max))
+    {
+        std::cerr << "Failed to redraw the plot frame." << std::endl;
+        return;
+    }
+    uploadTexture(window, plot_canvas);
+}
+
+void clear_tiles()
+{
+    for (auto& entry : tile_textures_)
+        glDeleteTextures(1, &entry.second.texture);
+    tile_textures_.clear();
+}
+
+void upload_tile(const SeriesTile& tile)
+{
+    if (tile.key.version != plot_series.version
+        || tile_textures_.count(tile.key))
+        return;
+
+    TileTexture& entry = tile_textures_[tile.key];
+    entry.used = tile_frame_;
+
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tile.canvas.width,
+                 tile.canvas.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 tile.canvas.rgba.data());
+}
+
+// Uploads the tiles rendered since the last call; false if there were none.
+bool upload_finished_tiles()
+{
+    std::vector<SeriesTile> finished;
+    TakeFinishedTiles(&finished);
+    for (const SeriesTile& tile : finished)
+        upload_tile(tile);
+    return !finished.empty();
+}
+
+void evict_tiles()
+{
+    while (tile_textures_.size() > TILE_CACHE_SIZE)
+    {
+        auto oldest = tile_textures_.begin();
+        for (auto it = tile_textures_.begin(); it != tile_textures_.end(); ++it)
+        {
+            if (it->second.used < oldest->second.used)
+                oldest = it;
+        }
+        if (oldest->second.used == tile_frame_)
+            break;
+
+        glDeleteTextures(1, &oldest->second.texture);
+        tile_textures_.erase(oldest);
+    }
+}
+
+// Draws a tile with the plot quad, clipped to the image rectangle
+// [x0, x1] x [y0, y1].
+void draw_tile(TileTexture& tile, const TileKey& key, double x0, double y0,
+               double x1, double y1, const int viewport[4])
+{
+    const double w = plot_series.width;
+    const double h = plot_series.height;
+    double tx0, ty0, tx1, ty1;
+    TileRect(key, view_, &tx0, &ty0, &tx1, &ty1);
+
+    float projection[4][4] = { { 1.0f, 0.0f, 0.0f, 0.0f },
+                               { 0.0f, 1.0f, 0.0f, 0.0f },
+                               { 0.0f, 0.0f, 1.0f, 0.0f },
+                               { 0.0f, 0.0f, 0.0f, 1.0f } };
+    projection[0][0] = float((tx1 - tx0) / w);
+    projection[1][1] = float((ty1 - ty0) / h);
+    projection[3][0] = float((tx0 + tx1) / w - 1.0);
+    projection[3][1] = float(1.0 - (ty0 + ty1) / h);
+    SetProjection(&projection_, projection);
+
+    image_scissor(x0, y0, x1, y1, viewport);
+    glBindTexture(GL_TEXTURE_2D, tile.texture);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    tile.used = tile_frame_;
+}
+
+// Draws the tiles covering the view with the plot quad program and VAO.
+// Tiles not rendered yet are asked for, and a cached tile of a coarser level
+// stands in for them meanwhile.
+void draw_series_tiles(const ShaderProgram& program, unsigned int vao,
+                       const int viewport[4])
+{
+    upload_finished_tiles();
+
+    std::vector<TileKey> keys, missing;
+    ViewTiles(plot_series, view_, &keys);
+    tile_frame_++;
+
+    glUseProgram(program.id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(vao);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_SCISSOR_TEST);
+
+    for (const TileKey& key : keys)
+    {
+        double x0, y0, x1, y1;
+        TileRect(key, view_, &x0, &y0, &x1, &y1);
+
+        auto it = tile_textures_.find(key);
+        if (it != tile_textures_.end())
+        {
+            draw_tile(it->second, key, x0, y0, x1, y1, viewport);
+            continue;
+        }
+
+        missing.push_back(key);
+        for (int up = 1; up <= 3; up++)
+        {
+            const TileKey parent = ParentTile(key, up);
+            it = tile_textures_.find(parent);
+            if (it != tile_textures_.end())
+            {
+                draw_tile(it->second, parent, x0, y0, x1, y1, viewport);
+                break;
+            }
+        }
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+
+    RequestTiles(missing);
+    evict_tiles();
+    tiles_missing_ = !missing.empty();
+}
+
 Vertex pixel_to_plot(const Vertex & v)
 {
     return Vertex{ plot_data.range_x_min
@@ -135,6 +447,41 @@ Vertex pixel_to_plot(const Vertex & v)
                            * (plot_data.range_y_max - plot_data.range_y_min) };
 }
 
+/////////////////////////////////////////////////////////////////////////
+// Live plot of a sample stream (--stream)
+
+// Draws the samples that arrived since the last frame.
+void update_live_plot()
+{
+    if (!streaming_)
+        return;
+
+    if (TakeStreamSamples(&stream_xs_, &stream_ys_) > 0)
+    {
+        if (AppendLivePlot(stream_xs_.data(), stream_ys_.data(),
+                           stream_xs_.size()))
+        {
+            updateTexture(plot_canvas);
+            redraw_ = true;
+            return;
+        }
+        std::cerr << "Failed to draw the stream." << std::endl;
+        StopSampleStream();
+    }
+    else
+    {
+        std::string error;
+        if (!SampleStreamEnded(&error))
+            return;
+        if (!error.empty())
+            std::cerr << error << std::endl;
+        std::cout << "Stream ended." << std::endl;
+    }
+
+    streaming_ = false;
+    FinishLivePlot(export_filename_);
+}
+
 /////////////////////////////////////////////////////////////////////////
 // Example of creating plot from given function
 
@@ -148,10 +495,14 @@ void on_key_a_pressed(GLFWwindow* window)
     plot_data.rgb[1] = 0.0;
     plot_data.rgb[2] = 1.0;
 
-    GeneratePlotFromFunc(
-        "plot.png", [](double x) { return sinf((float)x); }, 64, -PI * 2.0,
-        PI * 2.0);
-    reloadTexture(window, "plot.png");
+    auto gen = [](double x) { return sinf((float)x); };
+
+    if (adaptive_sampling_)
+        GeneratePlotFromFuncAdaptive(export_filename_, gen, AdaptiveSampling(),
+                                     -PI * 2.0, PI * 2.0);
+    else
+        GeneratePlotFromFunc(export_filename_, gen, 64, -PI * 2.0, PI * 2.0);
+    uploadTexture(window, plot_canvas);
 }
 
 /////////////////////////////////////////////////////////////////////////
@@ -168,11 +519,11 @@ void on_key_s_pressed(GLFWwindow* window)
     plot_data.rgb[1] = 1.0;
     plot_data.rgb[2] = 0.0;
 
-    if (!GeneratePlotFromPoints(plot_filename_, xs, ys))
+    if (!GeneratePlotFromPoints(export_filename_, xs, ys))
     {
         std::cerr << "Failed to generate initial plot image." << std::endl;
     }
-    reloadTexture(window, "plot.png");
+    uploadTexture(window, plot_canvas);
 }
 
 /////////////////////////////////////////////////////////////////////////
@@ -186,11 +537,11 @@ void on_key_d_pressed(GLFWwindow* window)
     plot_data.rgb[1] = 0.0;
     plot_data.rgb[2] = 0.0;
 
-    if (!GeneratePlotFromPoints(plot_filename_, plot_data.xs, plot_data.ys))
+    if (!GeneratePlotFromPoints(export_filename_, plot_data.xs, plot_data.ys))
     {
         std::cerr << "Failed to generate initial plot image." << std::endl;
     }
-    reloadTexture(window, "plot.png");
+    uploadTexture(window, plot_canvas);
 
     // clear previous points
     points_->vertices.clear();
@@ -213,19 +564,27 @@ void on_key_z_pressed(GLFWwindow* window)
     plot_data.rgb[1] = 0.0;
     plot_data.rgb[2] = 1.0;
 
-    GenerateContinuousPlotFromFunc(
-        "plot.png", [](double x) { return sinf((float)x); }, 64, -PI * 2.0,
-        PI * 2.0);
+    auto sin_gen = [](double x) { return sinf((float)x); };
+    auto cos_gen = [](double x) { return cosf((float)x); };
+
+    if (adaptive_sampling_)
+        GenerateContinuousPlotFromFuncAdaptive("", sin_gen, AdaptiveSampling(),
+                                               -PI * 2.0, PI * 2.0);
+    else
+        GenerateContinuousPlotFromFunc("", sin_gen, 64, -PI * 2.0, PI * 2.0);
 
     plot_data.rgb[0] = 1.0;
     plot_data.rgb[1] = 0.0;
     plot_data.rgb[2] = 0.0;
 
-    GenerateContinuousPlotFromFunc(
-        "plot.png", [](double x) { return cosf((float)x); }, 64, -PI * 2.0,
-        PI * 2.0);
+    if (adaptive_sampling_)
+        GenerateContinuousPlotFromFuncAdaptive(
+            export_filename_, cos_gen, AdaptiveSampling(), -PI * 2.0, PI * 2.0);
+    else
+        GenerateContinuousPlotFromFunc(export_filename_, cos_gen, 64, -PI * 2.0,
+                                       PI * 2.0);
 
-    reloadTexture(window, "plot.png");
+    uploadTexture(window, plot_canvas);
 
     FinishContinuousPlot();
 
@@ -243,6 +602,46 @@ void on_key_f_pressed(GLFWwindow* window) {}
 
 void on_key_g_pressed(GLFWwindow* window) {}
 
+// back to the view the series were plotted with
+void on_key_h_pressed(GLFWwindow* window)
+{
+    if (!view_enabled())
+        return;
+
+    view_ = HomeView(plot_series);
+    view_changed();
+}
+
+// export the plot currently on screen, compressed for keeping
+void on_key_p_pressed(GLFWwindow* window)
+{
+    if (WriteCanvasPNG(plot_canvas, plot_filename_, PngLevel::High))
+        std::cout << "Plot exported to '" << plot_filename_ << "'." << std::endl;
+    else
+        std::cerr << "Failed to export plot to '" << plot_filename_ << "'."
+                  << std::endl;
+}
+
+// replot the loaded data set for the current x/y range selection
+void replot_data_set(GLFWwindow* window)
+{
+    if (data_pyramid_.count == 0)
+        return;
+
+    if (!GeneratePlotFromPyramid(export_filename_, data_pyramid_))
+    {
+        std::cerr << "Failed to plot the data set." << std::endl;
+        return;
+    }
+    uploadTexture(window, plot_canvas);
+
+    // the selection markers refer to the old axes
+    lines_x_->vertices.clear();
+    lines_y_->vertices.clear();
+    updateRenderObject(lines_x_.get());
+    updateRenderObject(lines_y_.get());
+}
+
 // clear user interaction buffers
 void on_key_clear(GLFWwindow* window)
 {
@@ -261,6 +660,8 @@ void on_key_clear(GLFWwindow* window)
     plot_data.user_range_y[0] = 0.0;
     plot_data.user_range_y[1] = 0.0;
     updateRenderObject(lines_y_.get());
+
+    replot_data_set(window);
 }
 
 /////////////////////////////////////////////////////////////////////////
@@ -297,12 +698,262 @@ int main(int argc, char* argv[])
     app.add_option("-u,--range-maxy", plot_data.range_y_max, "Plot max Y")
         ->default_val(10.f);
 
+    app.add_option("-o,--output", export_filename_,
+                   "Also export every generated plot to this file, as PNG, "
+                   "raw RGBA, PPM or QOI by its extension");
+    const std::map<std::string, ImageFormat> image_formats{
+        { "auto", ImageFormat::Auto },
+        { "png", ImageFormat::Png },
+        { "raw", ImageFormat::Raw },
+        { "ppm", ImageFormat::Ppm },
+        { "qoi", ImageFormat::Qoi },
+    };
+    app.add_option("--format", plot_data.image_format,
+                   "Format of the --output file regardless of its extension: "
+                   "png, raw, ppm or qoi")
+        ->transform(CLI::CheckedTransformer(image_formats, CLI::ignore_case));
+    const std::map<std::string, PngLevel> png_levels{
+        { "store", PngLevel::Store },
+        { "fast", PngLevel::Fast },
+        { "high", PngLevel::High },
+    };
+    app.add_option("--png-level", plot_data.png_level,
+                   "Compression of the --output file: store, fast or high")
+        ->transform(CLI::CheckedTransformer(png_levels, CLI::ignore_case));
+    app.add_flag("--adaptive", adaptive_sampling_,
+                 "Sample functions adaptively to pixel accuracy");
+    app.add_flag("--parallel", plot_data.parallel_sampling,
+                 "Sample functions on all worker threads");
+    CLI::Option* gpu_series_option = app.add_flag("--gpu-series",
+                 plot_data.gpu_series,
+                 "Draw the plot series with OpenGL on top of the plot image; "
+                 "--output files then only hold the frame");
+    CLI::Option* tiles_option = app.add_flag("--tiles", tiled_series_,
+                 "Like --gpu-series, but draw the series from raster tiles "
+                 "rendered in the background and cached for panning and "
+                 "zooming");
+
+    bool vsync = false;
+    double max_fps = 0.0;
+    app.add_flag("--continuous", continuous_,
+                 "Redraw the window every frame, rather than only when it "
+                 "changes");
+    app.add_flag("--vsync", vsync,
+                 "Wait for the display's vertical sync with every frame");
+    app.add_option("--max-fps", max_fps,
+                   "Most frames drawn per second, 0 for no limit")
+        ->default_val(0.0)
+        ->check(CLI::NonNegativeNumber);
+
+    unsigned workers = 0;
+    app.add_option("-j,--threads", workers,
+                   "Worker threads, 0 for one per core")
+        ->default_val(0);
+
+    bool headless = false;
+    std::string jobs_filename;
+    CLI::Option* headless_option = app.add_flag("--headless", headless,
+        "Render the --jobs file without opening a window, then exit");
+    app.add_option("--jobs", jobs_filename,
+                   "Job file for --headless, one plot per line")
+        ->needs(headless_option);
+
+    std::string data_filename;
+    BinaryType data_type = BinaryType::Float64;
+    BinaryLayout data_layout = BinaryLayout::Pairs;
+    size_t data_header = 0;
+    CLI::Option* data_option = app.add_option("--data", data_filename,
+        "Binary x/y data file to plot, x sorted; it is memory mapped, "
+        "not read in");
+    const std::map<std::string, BinaryType> data_types{
+        { "f64", BinaryType::Float64 },
+        { "f32", BinaryType::Float32 },
+    };
+    app.add_option("--data-type", data_type,
+                   "Value type of the --data file: f64 or f32")
+        ->transform(CLI::CheckedTransformer(data_types, CLI::ignore_case))
+        ->needs(data_option);
+    const std::map<std::string, BinaryLayout> data_layouts{
+        { "pairs", BinaryLayout::Pairs },
+        { "columns", BinaryLayout::Columns },
+    };
+    app.add_option("--data-layout", data_layout,
+                   "Layout of the --data file: pairs (x y x y ...) or "
+                   "columns (all x, then all y)")
+        ->transform(CLI::CheckedTransformer(data_layouts, CLI::ignore_case))
+        ->needs(data_option);
+    app.add_option("--data-header", data_header,
+                   "Bytes to skip at the start of the --data file")
+        ->needs(data_option);
+
+    std::string csv_filename;
+    CsvOptions csv_options;
+    std::string csv_delimiter = "auto";
+    CLI::Option* csv_option = app.add_option("--csv", csv_filename,
+        "CSV/TSV x/y data file to plot; read in parallel")
+        ->excludes(data_option);
+    app.add_option("--csv-x", csv_options.x_column,
+                   "Column of the x values in the --csv file, from 0")
+        ->default_val(0)
+        ->needs(csv_option);
+    app.add_option("--csv-y", csv_options.y_column,
+                   "Column of the y values in the --csv file, from 0")
+        ->default_val(1)
+        ->needs(csv_option);
+    const std::map<std::string, char> csv_delimiters{
+        { "auto", 0 },
+        { "tab", '\t' },
+        { "comma", ',' },
+        { "semicolon", ';' },
+        { "space", ' ' },
+    };
+    app.add_option("--csv-delimiter", csv_delimiter,
+                   "Field separator of the --csv file: auto, tab, comma, "
+                   "semicolon or space")
+        ->check(CLI::IsMember(csv_delimiters, CLI::ignore_case))
+        ->needs(csv_option);
+
+    std::string stream_filename;
+    StreamFormat stream_format = StreamFormat::Text;
+    double stream_window = 10.0;
+    CLI::Option* stream_option = app.add_option("--stream", stream_filename,
+        "Plot x/y samples from a pipe, FIFO or file as they arrive, - for "
+        "stdin")
+        ->excludes(data_option)
+        ->excludes(csv_option)
+        ->excludes(gpu_series_option)
+        ->excludes(tiles_option);
+    const std::map<std::string, StreamFormat> stream_formats{
+        { "text", StreamFormat::Text },
+        { "f64", StreamFormat::Float64 },
+        { "f32", StreamFormat::Float32 },
+    };
+    app.add_option("--stream-format", stream_format,
+                   "Format of the --stream: text (x y per line), or f64/f32 "
+                   "x, y pairs")
+        ->transform(CLI::CheckedTransformer(stream_formats, CLI::ignore_case))
+        ->needs(stream_option);
+    app.add_option("--stream-window", stream_window,
+                   "Width of the x range the --stream plot scrolls through")
+        ->default_val(10.0)
+        ->check(CLI::PositiveNumber)
+        ->needs(stream_option);
+
     // 2. Parse the command line.
     // This macro includes a try/catch block and will exit cleanly on --help.
     CLI11_PARSE(app, argc, argv);
 
+    SetParallelWorkers(workers);
+    if (max_fps > 0.0)
+        frame_interval_ = 1.0 / max_fps;
+    if (tiled_series_)
+        plot_data.gpu_series = true;
 
-    if (!GenerateEmptyPlot(plot_filename_))
+    if (headless)
+    {
+        if (jobs_filename.empty())
+        {
+            std::cerr << "--headless needs a --jobs file." << std::endl;
+            return -1;
+        }
+        return RunBatchJobs(jobs_filename, plot_data) ? 0 : 1;
+    }
+
+    if (!data_filename.empty())
+    {
+        std::string error;
+        if (!LoadBinaryData(&data_file_, data_filename, data_type,
+                            data_layout, data_header, &error))
+        {
+            std::cerr << error << std::endl;
+            return -1;
+        }
+        if (!BuildMinMaxPyramid(&data_pyramid_, data_file_.xs, data_file_.ys,
+                                data_file_.count, data_file_.stride))
+        {
+            std::cerr << "The x values of '" << data_filename
+                      << "' are not sorted." << std::endl;
+            return -1;
+        }
+
+        plot_data.plot_name =
+            std::wstring(data_filename.begin(), data_filename.end());
+        plot_data.line_type = L"solid";
+        plot_data.rgb[0] = 0.0;
+        plot_data.rgb[1] = 0.0;
+        plot_data.rgb[2] = 1.0;
+    }
+
+    // unsorted --csv data is plotted once as it is, there is no pyramid
+    ScatterPlotSeries* csv_series = nullptr;
+
+    if (!csv_filename.empty())
+    {
+        csv_options.delimiter = csv_delimiters.at(csv_delimiter);
+
+        std::string error;
+        int shown = -1;
+        const bool loaded = LoadCsvData(csv_filename, csv_options, &csv_xs_,
+            &csv_ys_, [&](size_t done, size_t total) {
+                const int percent = int(done * 100 / total);
+                if (percent != shown)
+                {
+                    shown = percent;
+                    std::cout << "\rLoading '" << csv_filename << "' "
+                              << percent << "%" << std::flush;
+                }
+            }, &error);
+        std::cout << std::endl;
+        if (!loaded)
+        {
+            std::cerr << error << std::endl;
+            return -1;
+        }
+        if (csv_xs_.empty())
+        {
+            std::cerr << "No points in '" << csv_filename << "'." << std::endl;
+            return -1;
+        }
+
+        plot_data.plot_name =
+            std::wstring(csv_filename.begin(), csv_filename.end());
+        plot_data.line_type = L"solid";
+        plot_data.rgb[0] = 0.0;
+        plot_data.rgb[1] = 0.0;
+        plot_data.rgb[2] = 1.0;
+
+        if (!BuildMinMaxPyramid(&data_pyramid_, csv_xs_.data(),
+                                csv_ys_.data(), csv_xs_.size()))
+        {
+            csv_series = NewLineSeries(0);
+            csv_series->xs->swap(csv_xs_);
+            csv_series->ys->swap(csv_ys_);
+        }
+    }
+
+    if (!stream_filename.empty())
+    {
+        const std::string name = stream_filename == "-" ? "stdin"
+                                                        : stream_filename;
+        plot_data.plot_name = std::wstring(name.begin(), name.end());
+        plot_data.line_type = L"solid";
+        plot_data.rgb[0] = 0.0;
+        plot_data.rgb[1] = 0.0;
+        plot_data.rgb[2] = 1.0;
+        streaming_ = true;
+    }
+
+    // the loaded data set or the stream, if any, is the initial plot
+    bool plotted;
+    if (streaming_)
+        plotted = BeginLivePlot(stream_window);
+    else if (data_pyramid_.count > 0)
+        plotted = GeneratePlotFromPyramid(export_filename_, data_pyramid_);
+    else if (csv_series)
+        plotted = GeneratePlot(export_filename_, csv_series);
+    else
+        plotted = GenerateEmptyPlot(export_filename_);
+    if (!plotted)
     {
         std::cerr << "Failed to generate initial plot image." << std::endl;
         return -1;
@@ -317,23 +968,10 @@ int main(int argc, char* argv[])
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // Load initial image dimensions to create a well-sized window
-    int initial_width, initial_height, nrChannels;
-    unsigned char* initial_data =
-        stbi_load(plot_filename_.c_str(), &initial_width, &initial_height,
-                  &nrChannels, 0);
-    if (!initial_data)
-    {
-        std::cerr << "Failed to load initial texture to determine size."
-                  << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    stbi_image_free(initial_data);
-
     // --- GLFW window creation ---
+    // The initial plot is already in memory, so it dictates the window size
     GLFWwindow* window =
-        glfwCreateWindow(initial_width, initial_height,
+        glfwCreateWindow(plot_canvas.width, plot_canvas.height,
                          "PNG Viewer | Press 'R' to refresh", NULL, NULL);
     if (window == NULL)
     {
@@ -342,12 +980,15 @@ int main(int argc, char* argv[])
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(vsync ? 1 : 0);
 
     // --- Set Callbacks ---
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
     glfwSetKeyCallback(window, key_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetCursorPosCallback(window, cursor_position_callback);
+    glfwSetScrollCallback(window, scroll_callback);
 
     // --- GLAD ---
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -355,6 +996,12 @@ int main(int argc, char* argv[])
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2)
+        || glfwExtensionSupported("GL_ARB_texture_storage"))
+    {
+        tex_storage_2d_ =
+            (TexStorage2DProc)glfwGetProcAddress("glTexStorage2D");
+    }
 
     {
         float pcol[] = { 1.f, 0.f, 0.f };
@@ -372,38 +1019,23 @@ int main(int argc, char* argv[])
     }
 
     // --- Shaders (compile and link) ---
-    unsigned int shaderProgram = 0, overlayProgram = 0;
-    {
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-        glCompileShader(vertexShader);
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-        glCompileShader(fragmentShader);
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-    }
-
-    {
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexOvlSource, NULL);
-        glCompileShader(vertexShader);
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentOvlSource, NULL);
-        glCompileShader(fragmentShader);
-        overlayProgram = glCreateProgram();
-        glAttachShader(overlayProgram, vertexShader);
-        glAttachShader(overlayProgram, fragmentShader);
-        glLinkProgram(overlayProgram);
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+    ShaderProgram shaderProgram, overlayProgram;
+    {
+        std::string error;
+        if (!LoadShaderFunctions((GLADloadproc)glfwGetProcAddress)
+            || !CreateShaderProgram(&shaderProgram, vertexShaderSource,
+                                    fragmentShaderSource, &error)
+            || !CreateShaderProgram(&overlayProgram, vertexOvlSource,
+                                    fragmentOvlSource, &error))
+        {
+            std::cerr << "Failed to create the shaders. " << error
+                      << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        CreateProjectionBuffer(&projection_);
     }
 
-
     // --- Vertex Data for a Plot Quad ---
     float vertices[] = { // positions      // texture coords
                          1.0f, 1.0f,  0.0f, 1.0f,  0.0f,  1.0f, -1.0f,
@@ -429,19 +1061,38 @@ int main(int argc, char* argv[])
     glEnableVertexAttribArray(1);
 
     // --- Texture Generation ---
-    glGenTextures(1, &texture_id_); // Use the global texture ID
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    createPlotTexture();
+    glGenBuffers(2, texture_pbos_);
+
+    // Upload the initial plot straight from memory
+    uploadTexture(window, plot_canvas);
 
-    // Load the initial texture data using our new function
-    reloadTexture(window, plot_filename_);
+    if (streaming_)
+        StartSampleStream(stream_filename, stream_format, CsvOptions());
 
     // --- Render loop ---
     while (!glfwWindowShouldClose(window))
     {
+        update_live_plot();
+
+        if (frame_stale_ && !dragging_
+            && glfwGetTime() - view_changed_at_ > VIEW_SETTLE_SECONDS)
+            redraw_view_frame(window);
+
+        // tiles that were missing may have come in meanwhile
+        if (tiles_missing_ && upload_finished_tiles())
+            redraw_ = true;
+
+        if (!continuous_
+            && (!redraw_
+                || glfwGetTime() - frame_drawn_at_ < frame_interval_))
+        {
+            wait_for_changes();
+            continue;
+        }
+        redraw_ = false;
+        frame_drawn_at_ = glfwGetTime();
+
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
@@ -463,37 +1114,66 @@ int main(int argc, char* argv[])
         glViewport(view_x, view_y, view_width, view_height);
 
         // --- Draw Quad ---
-        glUseProgram(shaderProgram);
+        glUseProgram(shaderProgram.id);
         float projection[4][4] = { { 1.0f, 0.0f, 0.0f, 0.0f },
                                    { 0.0f, 1.0f, 0.0f, 0.0f },
                                    { 0.0f, 0.0f, 1.0f, 0.0f },
                                    { 0.0f, 0.0f, 0.0f, 1.0f } };
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1,
-                           GL_FALSE, &projection[0][0]);
+        SetProjection(&projection_, projection);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture_id_);
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
+        // --- Draw Series (--gpu-series, --tiles) ---
+        const int viewport[4] = { view_x, view_y, view_width, view_height };
+        if (!plot_series.series.empty() && tiled_series_)
+        {
+            draw_series_tiles(shaderProgram, VAO, viewport);
+        }
+        else if (!plot_series.series.empty())
+        {
+            float series_proj[4][4];
+            series_projection(series_proj);
+
+            glUseProgram(overlayProgram.id);
+            SetProjection(&projection_, series_proj);
+            glEnable(GL_SCISSOR_TEST);
+            image_scissor(0.0, 0.0, plot_series.width, plot_series.height,
+                          viewport);
+            for (const auto& series : series_)
+                drawRenderObject(series.get(), overlayProgram);
+            glDisable(GL_SCISSOR_TEST);
+        }
+
         // --- Draw Overlays ---
-        glUseProgram(overlayProgram);
-        glUniformMatrix4fv(glGetUniformLocation(overlayProgram, "projection"),
-                           1, GL_FALSE, &projection[0][0]);
+        glUseProgram(overlayProgram.id);
+        SetProjection(&projection_, projection);
         drawRenderObject(points_.get(), overlayProgram);
         drawRenderObject(lines_x_.get(), overlayProgram);
         drawRenderObject(lines_y_.get(), overlayProgram);
 
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (continuous_ && frame_interval_ > 0.0)
+            wait_for_changes();
+        else
+            glfwPollEvents();
     }
 
     // --- Cleanup ---
+    StopSampleStream();
+    StopTileRenderer();
+    clear_tiles();
+    CloseBinaryData(&data_file_);
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
+    DestroyShaderProgram(&shaderProgram);
+    DestroyShaderProgram(&overlayProgram);
+    DestroyProjectionBuffer(&projection_);
     glDeleteTextures(1, &texture_id_);
+    glDeleteBuffers(2, texture_pbos_);
 
     glfwTerminate();
     return 0;
@@ -501,36 +1181,194 @@ int main(int argc, char* argv[])
 
 /////////////////////////////////////////////////////////////////////////
 /**
- * @brief Reloads the PNG from disk and updates the active OpenGL texture.
- * @param filename The path to the PNG image file.
+ * @brief Uploads the in-memory plot canvas into the active OpenGL texture.
+ * @param canvas The RGBA8 canvas filled by the last plot call.
  */
-void reloadTexture(GLFWwindow* window, const std::string& filename)
+void uploadTexture(GLFWwindow* window, const Canvas& canvas)
 {
-    int new_width, new_height, nrChannels;
-    // Force loading the image with 4 channels (RGBA) for consistency
-    unsigned char* data =
-        stbi_load(filename.c_str(), &new_width, &new_height, &nrChannels, 4);
+    if (!canvas.rgba.empty())
+    {
+        // a frame redrawn for panning keeps the window as the user left it
+        const bool resized = texture_width_ != (int)canvas.width
+            || texture_height_ != (int)canvas.height;
+        texture_width_ = canvas.width;
+        texture_height_ = canvas.height;
+
+        // new storage holds nothing yet, the whole plot goes to it
+        if (resized)
+        {
+            allocatePlotTexture(texture_width_, texture_height_);
+            plot_dirty = CanvasRect(canvas);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture_id_);
+        uploadDirtyRect(canvas);
+        redraw_ = true;
+
+        if (resized)
+            glfwSetWindowSize(window, texture_width_, texture_height_);
+
+        uploadSeries();
 
-    if (data)
+        std::cout << "Texture uploaded (" << texture_width_ << "x"
+                  << texture_height_ << ")." << std::endl;
+    }
+    else
     {
-        texture_width_ = new_width;
-        texture_height_ = new_height;
+        std::cerr << "No plot image to upload." << std::endl;
+    }
+}
 
-        glBindTexture(GL_TEXTURE_2D, texture_id_);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture_width_, texture_height_,
-                     0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Uploads a canvas of the size last given to uploadTexture, without
+ * reallocating the texture or logging; for the live plot, every frame.
+ */
+void updateTexture(const Canvas& canvas)
+{
+    if (canvas.width != (uint32_t)texture_width_
+        || canvas.height != (uint32_t)texture_height_)
+        return;
 
-        glfwSetWindowSize(window, texture_width_, texture_height_);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    uploadDirtyRect(canvas);
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Passes the pixels of the bound texture's canvas marked in
+ * plot_dirty on to it and clears plot_dirty. The rows of the rectangle are
+ * copied into the next pixel buffer, which the texture is then filled from,
+ * so glTexSubImage2D returns without waiting for the driver's own copy.
+ */
+void uploadDirtyRect(const Canvas& canvas)
+{
+    const CanvasClip rect = plot_dirty;
+    plot_dirty = CanvasClip();
+    if (rect.x0 > rect.x1 || rect.y0 > rect.y1)
+        return;
+
+    const size_t width = rect.x1 - rect.x0 + 1;
+    const size_t height = rect.y1 - rect.y0 + 1;
+    const size_t row = width * 4;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture_pbos_[texture_pbo_next_]);
+    texture_pbo_next_ ^= 1;
 
-        stbi_image_free(data);
-        std::cout << "Texture '" << filename << "' reloaded (" << texture_width_
-                  << "x" << texture_height_ << ")." << std::endl;
+    // a buffer still being read is orphaned rather than waited for
+    uint8_t* pixels = (uint8_t*)glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, row * height,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (pixels)
+    {
+        for (size_t y = 0; y < height; y++)
+        {
+            std::memcpy(pixels + y * row,
+                        canvas.rgba.data()
+                            + ((rect.y0 + y) * canvas.width + rect.x0) * 4,
+                        row);
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x0, rect.y0, (GLsizei)width,
+                        (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Makes texture_id_ a new plot texture, sampled without mipmaps.
+ */
+void createPlotTexture()
+{
+    glGenTextures(1, &texture_id_);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Gives the plot texture and its pixel buffers room for a plot of
+ * the given size. Immutable storage cannot be resized, so that texture is
+ * replaced by a new one.
+ */
+void allocatePlotTexture(int width, int height)
+{
+    if (tex_storage_2d_)
+    {
+        glDeleteTextures(1, &texture_id_);
+        createPlotTexture();
+        tex_storage_2d_(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
     }
     else
     {
-        std::cerr << "Failed to reload texture from '" << filename << "'."
-                  << std::endl;
+        glBindTexture(GL_TEXTURE_2D, texture_id_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    for (unsigned int pbo : texture_pbos_)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (size_t)width * height * 4,
+                     nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Uploads the series recorded with the last plot into vertex buffers,
+ * or hands them to the tile renderer with --tiles, and resets the view.
+ * This happens once per plot; drawing them afterwards only sets a
+ * projection, see series_projection.
+ */
+void uploadSeries()
+{
+    const std::vector<PlotSeries>& series = plot_series.series;
+
+    if (plot_series.version == view_version_)
+        return;
+    view_version_ = plot_series.version;
+    view_ = HomeView(plot_series);
+    frame_stale_ = false;
+
+    if (tiled_series_)
+    {
+        clear_tiles();
+        SetTileSeries(plot_series);
+        return;
+    }
+
+    while (series_.size() < series.size())
+    {
+        float scol[] = { 0.f, 0.f, 0.f };
+        series_.emplace_back(createRenderObject(GL_LINE_STRIP, scol, 1.f));
+    }
+
+    for (size_t i = 0; i < series_.size(); i++)
+    {
+        RenderObject* object = series_[i].get();
+        object->vertices.clear();
+
+        if (i < series.size())
+        {
+            const PlotSeries& s = series[i];
+            object->drawing_mode = s.lines ? GL_LINE_STRIP : GL_POINTS;
+            object->size = s.size;
+            object->color[0] = s.rgb[0];
+            object->color[1] = s.rgb[1];
+            object->color[2] = s.rgb[2];
+
+            object->vertices.reserve(s.xy.size() / 2);
+            for (size_t j = 0; j + 1 < s.xy.size(); j += 2)
+                object->vertices.push_back(Vertex{ s.xy[j], s.xy[j + 1] });
+        }
+
+        updateRenderObject(object);
     }
 }
 
@@ -548,16 +1386,22 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action,
     }
 
     key_pressed_ = key;
+    redraw_ = true;
 
     switch (key)
     {
         case GLFW_KEY_ESCAPE: glfwSetWindowShouldClose(window, true); break;
-        case GLFW_KEY_R: reloadTexture(window, "plot.png"); break;
+        case GLFW_KEY_R:
+            plot_dirty = CanvasRect(plot_canvas);
+            uploadTexture(window, plot_canvas);
+            break;
         case GLFW_KEY_A: on_key_a_pressed(window); break;
         case GLFW_KEY_S: on_key_s_pressed(window); break;
         case GLFW_KEY_D: on_key_d_pressed(window); break;
         case GLFW_KEY_F: on_key_f_pressed(window); break;
         case GLFW_KEY_G: on_key_g_pressed(window); break;
+        case GLFW_KEY_H: on_key_h_pressed(window); break;
+        case GLFW_KEY_P: on_key_p_pressed(window); break;
         case GLFW_KEY_Z: on_key_z_pressed(window); break;
 
         case GLFW_KEY_C: on_key_clear(window); break;
@@ -641,6 +1485,16 @@ void mouse_button_y_range(const double& xpos, const double& ypos)
  */
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
+    redraw_ = true;
+
+    // the right button drags the view around
+    if (button == GLFW_MOUSE_BUTTON_RIGHT)
+    {
+        dragging_ = action == GLFW_PRESS && view_enabled();
+        glfwGetCursorPos(window, &drag_x_, &drag_y_);
+        return;
+    }
+
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
     {
         double xpos, ypos;
@@ -649,10 +1503,14 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         if (key_pressed_ == GLFW_KEY_X)
         {
             mouse_button_x_range(xpos, ypos);
+            if (key_pressed_ == 0)
+                replot_data_set(window);
         }
         else if (key_pressed_ == GLFW_KEY_Y)
         {
             mouse_button_y_range(xpos, ypos);
+            if (key_pressed_ == 0)
+                replot_data_set(window);
         }
         else
         {
@@ -671,6 +1529,8 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                 v.y=-v.y;
                 points_->vertices.push_back(v);
 
+                markRenderObjectDirty(points_.get(),
+                                      points_->vertices.size() - 1, 1);
                 updateRenderObject(points_.get());
             }
         }
@@ -681,6 +1541,19 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
 {
+    if (dragging_)
+    {
+        view_.x += xpos - drag_x_;
+        view_.y += ypos - drag_y_;
+        drag_x_ = xpos;
+        drag_y_ = ypos;
+        view_changed();
+    }
+
+    // only the range lines follow the cursor
+    if (key_pressed_ == GLFW_KEY_X || key_pressed_ == GLFW_KEY_Y)
+        redraw_ = true;
+
     if (key_pressed_ == GLFW_KEY_X)
     {
         Vertex v0 = { float(xpos / plot_data.pix_x) * 2.f - 1.f, -1.f };
@@ -698,6 +1571,7 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
         }
         lines_x_->vertices[i0] = v0;
         lines_x_->vertices[i1] = v1;
+        markRenderObjectDirty(lines_x_.get(), i0, 2);
         updateRenderObject(lines_x_.get());
     }
     else if (key_pressed_ == GLFW_KEY_Y)
@@ -717,6 +1591,7 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
         }
         lines_y_->vertices[i0] = v0;
         lines_y_->vertices[i1] = v1;
+        markRenderObjectDirty(lines_y_.get(), i0, 2);
         updateRenderObject(lines_y_.get());
     }
 }
@@ -728,6 +1603,65 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // The viewport is handled dynamically in the main render loop to maintain
-    // aspect ratio. This function is still required by GLFW but can be left
-    // empty for our purpose.
-}
\ No newline at end of file
+    // aspect ratio; it only has to be drawn again.
+    redraw_ = true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Draws the window again when the system asks for it, e.g. after
+ * it was uncovered.
+ */
+void window_refresh_callback(GLFWwindow* window)
+{
+    redraw_ = true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Sleeps until an event comes in, or until the next thing the render
+ * loop has to look at without one: the stream, missing tiles, the view
+ * settling, or the next frame the --max-fps limit allows.
+ */
+void wait_for_changes()
+{
+    const double now = glfwGetTime();
+    bool has_deadline = false;
+    double timeout = 0.0;
+
+    // a deadline already passed polls rather than waiting for input
+    auto until = [&](double deadline) {
+        const double left = std::max(0.0, deadline - now);
+        timeout = has_deadline ? std::min(timeout, left) : left;
+        has_deadline = true;
+    };
+
+    if (streaming_ || tiles_missing_)
+        until(now + POLL_SECONDS);
+    if (frame_stale_ && !dragging_)
+        until(view_changed_at_ + VIEW_SETTLE_SECONDS);
+    if (redraw_ || continuous_)
+        until(frame_drawn_at_ + frame_interval_);
+
+    if (!has_deadline)
+        glfwWaitEvents();
+    else if (timeout > 0.0)
+        glfwWaitEventsTimeout(timeout);
+    else
+        glfwPollEvents();
+}
+
+/////////////////////////////////////////////////////////////////////////
+/**
+ * @brief Zooms the recorded series around the cursor with the mouse wheel.
+ */
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    if (!view_enabled())
+        return;
+
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    ZoomView(&view_, std::pow(1.25, yoffset), xpos, ypos);
+    view_changed();
+}
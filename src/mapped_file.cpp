@@ -0,0 +1,101 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MapFile(MappedFile* file, const std::string& filename,
+    std::string* error)
+{
+    UnmapFile(file);
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ,
+                                FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        *error = "cannot open '" + filename + "'";
+        return false;
+    }
+    file->file_handle = handle;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        *error = "'" + filename + "' is empty";
+        UnmapFile(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0,
+                                        NULL);
+    if (mapping != NULL)
+    {
+        file->mapping_handle = mapping;
+        file->data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0,
+                                                   0, 0);
+        file->size = (size_t)size.QuadPart;
+    }
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        *error = "cannot open '" + filename + "'";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        *error = "'" + filename + "' is empty";
+        return false;
+    }
+
+    // the mapping keeps the file open by itself
+    void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                     0);
+    close(fd);
+    if (map != MAP_FAILED)
+    {
+        file->data = (const uint8_t*)map;
+        file->size = (size_t)st.st_size;
+    }
+#endif
+
+    if (!file->data)
+    {
+        *error = "cannot map '" + filename + "'";
+        UnmapFile(file);
+        return false;
+    }
+    return true;
+}
+
+void UnmapFile(MappedFile* file)
+{
+#ifdef _WIN32
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->mapping_handle)
+        CloseHandle((HANDLE)file->mapping_handle);
+    if (file->file_handle)
+        CloseHandle((HANDLE)file->file_handle);
+#else
+    if (file->data)
+        munmap((void*)file->data, file->size);
+#endif
+
+    file->data = nullptr;
+    file->size = 0;
+    file->file_handle = nullptr;
+    file->mapping_handle = nullptr;
+}
@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A file mapped read-only into memory.
+struct MappedFile
+{
+    const uint8_t* data=nullptr;
+    size_t size=0;
+
+    // handles kept open on Windows
+    void* file_handle=nullptr;
+    void* mapping_handle=nullptr;
+};
+
+/**
+ * @brief Maps the whole file read-only; pages are read in as they are
+ * touched.
+ * @return false with a message in error if the file cannot be opened, is
+ * empty or cannot be mapped.
+ */
+bool MapFile(MappedFile* file, const std::string& filename,
+    std::string* error);
+
+void UnmapFile(MappedFile* file);
+
+#endif // MAPPED_FILE_H
@@ -1,7 +1,11 @@
 #include "overlay.h"
+#include <algorithm>
 #include <iostream>
 #include <cstring> // For memcpy
 
+// Smallest buffer allocated, in vertices
+static const size_t MIN_VERTEX_CAPACITY = 64;
+
 RenderObject* createRenderObject(GLenum mode, const float obj_color[3], float obj_size) {
     RenderObject* object = new RenderObject();
     if (!object) {
@@ -34,30 +38,59 @@ void destroyRenderObject(RenderObject* object) {
     delete object;
 }
 
+void markRenderObjectDirty(RenderObject* object, size_t first, size_t count) {
+    if (!object || count == 0) return;
+    if (object->dirty_first == object->dirty_last) {
+        object->dirty_first = first;
+        object->dirty_last = first + count;
+    } else {
+        object->dirty_first = std::min(object->dirty_first, first);
+        object->dirty_last = std::max(object->dirty_last, first + count);
+    }
+}
+
 void updateRenderObject(RenderObject* object) {
     if (!object) return;
+
+    const size_t size = object->vertices.size();
+    size_t first = 0;
+    size_t last = size;
+
+    glBindBuffer(GL_ARRAY_BUFFER, object->vbo);
+    if (size > object->capacity) {
+        // Grown geometrically, so appending one vertex at a time stays cheap
+        object->capacity = std::max({ size, object->capacity * 2, MIN_VERTEX_CAPACITY });
+        glBufferData(GL_ARRAY_BUFFER, object->capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+    } else if (object->dirty_first != object->dirty_last) {
+        first = object->dirty_first;
+        last = std::min(object->dirty_last, size);
+        // Vertices appended since the last update go along
+        if (size > object->uploaded) {
+            first = std::min(first, object->uploaded);
+            last = size;
+        }
+    }
+
     // It's okay to update an object with zero vertices (clearing it)
-    if (object->vertices.empty()) {
-        glBindBuffer(GL_ARRAY_BUFFER, object->vbo);
-        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        return;
+    if (last > first) {
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), (last - first) * sizeof(Vertex),
+                        object->vertices.data() + first);
     }
-    glBindBuffer(GL_ARRAY_BUFFER, object->vbo);
-    glBufferData(GL_ARRAY_BUFFER, object->vertices.size() * sizeof(Vertex), object->vertices.data(), GL_DYNAMIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    object->uploaded = size;
+    object->dirty_first = object->dirty_last = 0;
 }
 
-void drawRenderObject(const RenderObject* object, unsigned int shader_program_id) {
-    if (!object || object->vertices.empty()) return;
+void drawRenderObject(const RenderObject* object, const ShaderProgram& program) {
+    if (!object || object->uploaded == 0) return;
 
     // Set the per-object properties before drawing
     // Note: The shader program is assumed to be in use already by the caller.
 
     // 1. Set the color uniform
-    GLint color_loc = glGetUniformLocation(shader_program_id, "objectColor");
-    if (color_loc != -1) {
-        glUniform3fv(color_loc, 1, object->color);
+    if (program.object_color != -1) {
+        glUniform3fv(program.object_color, 1, object->color);
     }
 
     // 2. Set the size (for points or lines)
@@ -69,6 +102,6 @@ void drawRenderObject(const RenderObject* object, unsigned int shader_program_id
 
     // 3. Bind the VAO and draw the object
     glBindVertexArray(object->vao);
-    glDrawArrays(object->drawing_mode, 0, (GLsizei)object->vertices.size());
+    glDrawArrays(object->drawing_mode, 0, (GLsizei)object->uploaded);
     glBindVertexArray(0);
 }
\ No newline at end of file
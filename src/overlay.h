@@ -1,8 +1,10 @@
 #ifndef RENDER_OBJECTS_H
 #define RENDER_OBJECTS_H
 
+#include <cstddef>
 #include <vector>
 #include <glad/glad.h>
+#include "shader.h"
 
 // Represents a single 2D vertex
 struct Vertex {
@@ -17,6 +19,11 @@ struct RenderObject {
     std::vector<Vertex> vertices;
     float color[3]; // RGB color
     float size;     // For point size or line width
+
+    size_t capacity = 0;    // Vertices the buffer has room for
+    size_t uploaded = 0;    // Vertices in the buffer, the ones drawn
+    size_t dirty_first = 0; // Vertices changed in place, [first, last)
+    size_t dirty_last = 0;
 };
 
 /**
@@ -36,9 +43,23 @@ RenderObject* createRenderObject(GLenum mode, const float obj_color[3], float ob
 */
 void destroyRenderObject(RenderObject* object);
 
+/**
+* @brief Marks vertices changed in place, for the next updateRenderObject.
+*
+* @param object The RenderObject whose vertices changed.
+* @param first The first vertex changed.
+* @param count The number of vertices changed from there.
+*/
+void markRenderObjectDirty(RenderObject* object, size_t first, size_t count);
+
 /**
 * @brief Updates the object's vertex buffer on the GPU.
 *
+* Only the vertices marked with markRenderObjectDirty and those appended
+* since the last update are uploaded; with none marked, all of them are.
+* The buffer grows to twice its size when the vertices outgrow it, and is
+* never shrunk, so clearing and refilling an object does not reallocate.
+*
 * @param object The RenderObject to update.
 */
 void updateRenderObject(RenderObject* object);
@@ -47,8 +68,8 @@ void updateRenderObject(RenderObject* object);
 * @brief Draws the RenderObject, setting its unique color and size uniforms.
 *
 * @param object The RenderObject to draw.
-* @param shader_program_id The ID of the shader program to use for drawing.
+* @param program The shader program to use for drawing, already in use.
 */
-void drawRenderObject(const RenderObject* object, unsigned int shader_program_id);
+void drawRenderObject(const RenderObject* object, const ShaderProgram& program);
 
 #endif // RENDER_OBJECTS_H
\ No newline at end of file
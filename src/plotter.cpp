@@ -1,64 +1,262 @@
 #include "plotter.h"
 #include "supportLib.hpp"
+#include "decimate.h"
+#include "bounds.h"
+#include "clip.h"
+#include "raster.h"
 
+#include <algorithm>
 #include <cfloat>
+#include <cmath>
+#include <cstring>
 #include <vector>
 
-std::vector<wchar_t>* new_vec_char (const std::wstring& str)
-{
-    return new std::vector<wchar_t>(str.begin(), str.end());
-}
+thread_local Canvas plot_canvas;
+thread_local CanvasClip plot_dirty;
+thread_local PlotSeriesList plot_series;
 
-bool GeneratePlotFromFunc(const std::string& filename,
-    const std::function<double(double)>& gen, const uint32_t& num, double xmin, double xmax)
+// Persistent canvas that ContinuousPlot keeps drawing series onto until
+// FinishContinuousPlot; empty while no continuous plot is in progress.
+static thread_local Canvas gcanvas;
+
+namespace {
+
+// Everything a plot call hands to pbPlots. It lives for the whole program
+// and is reset by every plot call, so replots reuse its storage instead of
+// leaking a fresh set of settings, series, vectors and strings each time.
+struct PlotContext
 {
+    ScatterPlotSettings settings;
+    std::vector<ScatterPlotSeries*> series_list;
+    std::vector<wchar_t> title;
+    std::vector<wchar_t> x_label;
+    std::vector<wchar_t> y_label;
+    StringReference error;
+
+    // the series handed out by NewLineSeries
+    ScatterPlotSeries series;
     std::vector<double> xs;
     std::vector<double> ys;
+    std::vector<wchar_t> line_type;
+    RGBA color;
+
+    // scratch space of AmendScatterPlotFromSettings
+    std::vector<double> decimated_xs;
+    std::vector<double> decimated_ys;
+    std::vector<double> pixel_points;
+    std::vector<PixelSegment> segments;
+    RasterList raster;
+
+    // last frame drawn by pbPlots and the settings it was drawn for
+    Canvas frame;
+    ScatterPlotSettings frame_settings;
+    std::vector<wchar_t> frame_title;
+    std::vector<wchar_t> frame_x_label;
+    std::vector<wchar_t> frame_y_label;
+    bool frame_valid = false;
+};
 
-    double xi = xmin;
-    double xstep = (xmax-xmin)/num;
+thread_local PlotContext context_;
 
-    for (auto i=0; i<num+1; i++)
-    {
-        xs.push_back(xi);
-        ys.push_back(gen(xs.back()));
-        xi+=xstep;
-    }
+bool DrawPlotFrame(Canvas *canvas, ScatterPlotSettings *settings, StringReference *errorMessage);
+bool AmendScatterPlotFromSettings(Canvas *canvas, ScatterPlotSettings *settings, StringReference *errorMessage, CanvasClip *dirty = nullptr);
+
+void AssignText(std::vector<wchar_t>* dst, const std::wstring& str)
+{
+    dst->assign(str.begin(), str.end());
+}
 
-    ScatterPlotSeries *series = GetDefaultScatterPlotSeriesSettings();
-    series->xs = new std::vector<double>(xs);
-    series->ys = new std::vector<double>(ys);
+// Resets the context settings to pbPlots' defaults, sized and padded from
+// plot_data, with fixed bounds and no series yet.
+ScatterPlotSettings* ResetSettings(const std::wstring& title)
+{
+    // pbPlots' defaults are fetched once and copied from then on
+    static const ScatterPlotSettings* defaults = GetDefaultScatterPlotSettings();
+    PlotContext& c = context_;
+
+    c.settings = *defaults;
+    c.series_list.clear();
+    AssignText(&c.title, title);
+    AssignText(&c.x_label, L"X axis");
+    AssignText(&c.y_label, L"Y axis");
+    c.error.string = nullptr;
+
+    ScatterPlotSettings* settings = &c.settings;
+    settings->width = plot_data.pix_x;
+    settings->height = plot_data.pix_y;
+    settings->autoBoundaries = false;
+    settings->autoPadding = false;
+    settings->xPadding=plot_data.pad_x;
+    settings->yPadding=plot_data.pad_y;
+    settings->title = &c.title;
+    settings->xLabel = &c.x_label;
+    settings->yLabel = &c.y_label;
+    settings->scatterPlotSeries = &c.series_list;
+
+    return settings;
+}
+
+}
+
+ScatterPlotSeries* NewLineSeries(size_t count)
+{
+    static const ScatterPlotSeries* defaults = GetDefaultScatterPlotSeriesSettings();
+    PlotContext& c = context_;
+
+    c.series = *defaults;
+    c.xs.resize(count);
+    c.ys.resize(count);
+    AssignText(&c.line_type, plot_data.line_type);
+    c.color.r = plot_data.rgb[0];
+    c.color.g = plot_data.rgb[1];
+    c.color.b = plot_data.rgb[2];
+    c.color.a = 1.0;
+
+    ScatterPlotSeries *series = &c.series;
+    series->xs = &c.xs;
+    series->ys = &c.ys;
     series->linearInterpolation = true;
-    series->lineType = new_vec_char(plot_data.line_type);
+    series->lineType = &c.line_type;
     series->lineThickness = 2;
-    series->color = CreateRGBColor(plot_data.rgb[0], plot_data.rgb[1], plot_data.rgb[2]);
+    series->color = &c.color;
 
-    return GeneratePlot(filename, series);
+    return series;
 }
 
-bool GenerateContinuousPlotFromFunc(const std::string& filename,
-    const std::function<double(double)>& gen, const uint32_t& num, double xmin, double xmax)
+// Starts a new plot: the series recorded for the last one are gone.
+static void ClearPlotSeries()
 {
-    std::vector<double> xs;
-    std::vector<double> ys;
+    plot_series.series.clear();
+    plot_series.version++;
+}
+
+// Rows of plot_canvas changed since it was last exported, to the file named
+// here, so exporting to that file again only has to pass those on.
+static thread_local CanvasClip export_dirty_;
+static thread_local std::string export_name_;
 
-    double xi = xmin;
-    double xstep = (xmax-xmin)/num;
+// What plot_canvas was last drawn from as a whole: gcanvas, the live plot,
+// or nothing in particular. Only then can it be brought up to date with
+// just the pixels that source changed.
+static thread_local const void* plot_canvas_source_ = nullptr;
 
-    for (auto i=0; i<num+1; i++)
+static void MarkPlotDirty(const CanvasClip& rect)
+{
+    CanvasGrowRect(&plot_dirty, rect);
+    CanvasGrowRect(&export_dirty_, rect);
+}
+
+// plot_canvas was drawn anew, from source.
+static void MarkPlotRedrawn(const void* source = nullptr)
+{
+    MarkPlotDirty(CanvasRect(plot_canvas));
+    plot_canvas_source_ = source;
+}
+
+static size_t SeriesListBytes(const PlotSeriesList& list)
+{
+    size_t bytes = 0;
+    for (const PlotSeries& s : list.series)
+        bytes += s.xy.capacity() * sizeof(float);
+    return bytes;
+}
+
+size_t PlotContextBytes()
+{
+    const PlotContext& c = context_;
+
+    return sizeof(PlotContext)
+        + c.series_list.capacity() * sizeof(ScatterPlotSeries*)
+        + (c.title.capacity() + c.x_label.capacity() + c.y_label.capacity()
+           + c.line_type.capacity() + c.frame_title.capacity()
+           + c.frame_x_label.capacity() + c.frame_y_label.capacity())
+            * sizeof(wchar_t)
+        + (c.xs.capacity() + c.ys.capacity() + c.decimated_xs.capacity()
+           + c.decimated_ys.capacity() + c.pixel_points.capacity())
+            * sizeof(double)
+        + c.segments.capacity() * sizeof(PixelSegment)
+        + c.raster.styles.capacity() * sizeof(RasterStyle)
+        + c.raster.commands.capacity() * sizeof(RasterCommand)
+        + (c.raster.tile_starts.capacity() + c.raster.tile_commands.capacity())
+            * sizeof(uint32_t)
+        + c.frame.rgba.capacity() + plot_canvas.rgba.capacity()
+        + gcanvas.rgba.capacity()
+        + plot_series.series.capacity() * sizeof(PlotSeries)
+        + SeriesListBytes(plot_series);
+}
+
+// Adaptive sampling judged against the plot area of plot_data.
+static AdaptiveSampling PlotAreaSampling(const AdaptiveSampling& sampling)
+{
+    AdaptiveSampling s = sampling;
+    s.width_px = double(plot_data.pix_x) - plot_data.pad_x * 2.0;
+    s.height_px = double(plot_data.pix_y) - plot_data.pad_y * 2.0;
+    return s;
+}
+
+// The PNG export is only done when a filename is given; an empty one keeps
+// the plot in memory. Exporting to the file of the last export again only
+// updates the rows changed since, see UpdateImageFile.
+static bool ExportCanvas(const std::string& filename, const Canvas& canvas)
+{
+    if (filename.empty())
+        return true;
+    if (canvas.rgba.empty())
+        return false;
+
+    bool success = true;
+    if (filename != export_name_)
     {
-        xs.push_back(xi);
-        ys.push_back(gen(xs.back()));
-        xi+=xstep;
+        success = WriteCanvasImage(canvas, filename, plot_data.image_format,
+                                   plot_data.png_level);
+    }
+    else if (export_dirty_.y0 <= export_dirty_.y1)
+    {
+        success = UpdateImageFile(filename, canvas.rgba.data(), canvas.width,
+                                  canvas.height, export_dirty_.y0,
+                                  export_dirty_.y1, plot_data.image_format,
+                                  plot_data.png_level);
     }
 
-    ScatterPlotSeries *series = GetDefaultScatterPlotSeriesSettings();
-    series->xs = new std::vector<double>(xs);
-    series->ys = new std::vector<double>(ys);
-    series->linearInterpolation = true;
-    series->lineType = new_vec_char(plot_data.line_type);
-    series->lineThickness = 2;
-    series->color = CreateRGBColor(plot_data.rgb[0], plot_data.rgb[1], plot_data.rgb[2]);
+    export_name_ = success ? filename : std::string();
+    export_dirty_ = CanvasClip();
+    return success;
+}
+
+bool GeneratePlotFromFunc(const std::string& filename,
+    const std::function<double(double)>& gen, const uint32_t& num, double xmin, double xmax)
+{
+    return GeneratePlotFromFunc<std::function<double(double)>>(filename, gen, num, xmin, xmax);
+}
+
+bool GenerateContinuousPlotFromFunc(const std::string& filename,
+    const std::function<double(double)>& gen, const uint32_t& num, double xmin, double xmax)
+{
+    return GenerateContinuousPlotFromFunc<std::function<double(double)>>(filename, gen, num, xmin, xmax);
+}
+
+bool GeneratePlotFromFuncAdaptive(const std::string& filename,
+    const std::function<double(double)>& gen, const AdaptiveSampling& sampling, double xmin, double xmax)
+{
+    ScatterPlotSeries *series = NewLineSeries(0);
+
+    // y bounds follow the data here, so they come from the first samples
+    AdaptiveSampling s = PlotAreaSampling(sampling);
+    s.y_min = s.y_max = 0.0;
+    SampleFunctionAdaptive(gen, xmin, xmax, s, series->xs, series->ys);
+
+    return GeneratePlot(filename, series);
+}
+
+bool GenerateContinuousPlotFromFuncAdaptive(const std::string& filename,
+    const std::function<double(double)>& gen, const AdaptiveSampling& sampling, double xmin, double xmax)
+{
+    ScatterPlotSeries *series = NewLineSeries(0);
+
+    AdaptiveSampling s = PlotAreaSampling(sampling);
+    s.y_min = plot_data.range_y_min;
+    s.y_max = plot_data.range_y_max;
+    SampleFunctionAdaptive(gen, xmin, xmax, s, series->xs, series->ys);
 
     return ContinuousPlot(filename, series);
 }
@@ -67,13 +265,9 @@ bool GeneratePlotFromPoints(const std::string& filename,
                             const std::vector<double>& xs, 
                             const std::vector<double>& ys)
 {
-    ScatterPlotSeries *series = GetDefaultScatterPlotSeriesSettings();
-    series->xs = new std::vector<double>(xs);
-    series->ys = new std::vector<double>(ys);
-    series->linearInterpolation = true;
-    series->lineType = new_vec_char(plot_data.line_type);
-    series->lineThickness = 2;
-    series->color = CreateRGBColor(plot_data.rgb[0], plot_data.rgb[1], plot_data.rgb[2]);
+    ScatterPlotSeries *series = NewLineSeries(0);
+    series->xs->assign(xs.begin(), xs.end());
+    series->ys->assign(ys.begin(), ys.end());
 
     return GeneratePlot(filename, series);
 }
@@ -88,12 +282,18 @@ bool CalculateBounds(ScatterPlotSettings* settings, ScatterPlotSeries* series)
     settings->yMin = FLT_MAX;
     settings->yMax = -FLT_MAX;
 
-    for (int i = 0; i < series->xs->size(); i++)
+    MinMax x = FindMinMax(series->xs->data(), series->xs->size());
+    MinMax y = FindMinMax(series->ys->data(), series->ys->size());
+
+    if (x.min <= x.max)
+    {
+        settings->xMin = x.min;
+        settings->xMax = x.max;
+    }
+    if (y.min <= y.max)
     {
-        settings->xMin = std::min((*series->xs)[i], settings->xMin);
-        settings->xMax = std::max((*series->xs)[i], settings->xMax);
-        settings->yMin = std::min((*series->ys)[i], settings->yMin);
-        settings->yMax = std::max((*series->ys)[i], settings->yMax);
+        settings->yMin = y.min;
+        settings->yMax = y.max;
     }
 
     plot_data.range_x_min = settings->xMin;
@@ -103,86 +303,184 @@ bool CalculateBounds(ScatterPlotSettings* settings, ScatterPlotSeries* series)
     return true;
 }
 
-bool GeneratePlot(const std::string& filename, ScatterPlotSeries *series) {
+// Like CalculateBounds, but with x fixed to [xmin, xmax] and y covering
+// only the points inside it, unless [ymin, ymax] is given as well.
+bool CalculateBoundsInRange(ScatterPlotSettings* settings, ScatterPlotSeries* series,
+    double xmin, double xmax, double ymin, double ymax)
+{
+    if(!settings || !series)
+        return false;
 
-    ScatterPlotSettings* settings = GetDefaultScatterPlotSettings();
+    settings->xMin = xmin;
+    settings->xMax = xmax;
+    settings->yMin = ymin;
+    settings->yMax = ymax;
 
-    CalculateBounds(settings, series);
+    if (ymin == ymax)
+    {
+        settings->yMin = FLT_MAX;
+        settings->yMax = -FLT_MAX;
+
+        for (size_t i = 0; i < series->xs->size(); i++)
+        {
+            double x = (*series->xs)[i];
+            if (x >= xmin && x <= xmax && std::isfinite((*series->ys)[i]))
+            {
+                settings->yMin = std::min((*series->ys)[i], settings->yMin);
+                settings->yMax = std::max((*series->ys)[i], settings->yMax);
+            }
+        }
 
-    settings->width = plot_data.pix_x;
-    settings->height = plot_data.pix_y;
-    settings->autoBoundaries = false;
-    settings->autoPadding = false;
-    settings->xPadding=plot_data.pad_x;
-    settings->yPadding=plot_data.pad_y;
-    settings->title = new_vec_char(plot_data.plot_name);
-    settings->xLabel = new_vec_char(L"X axis");
-    settings->yLabel = new_vec_char(L"Y axis");
-    settings->scatterPlotSeries = new std::vector<ScatterPlotSeries*> {series};
+        if (settings->yMin > settings->yMax)
+        {
+            settings->yMin = plot_data.range_y_min;
+            settings->yMax = plot_data.range_y_max;
+        }
+    }
 
-    RGBABitmapImageReference* imageReference = CreateRGBABitmapImageReference();
-    StringReference *errorMessage = new StringReference();
-    bool success = DrawScatterPlotFromSettings(imageReference, settings, errorMessage);
+    plot_data.range_x_min = settings->xMin;
+    plot_data.range_x_max = settings->xMax;
+    plot_data.range_y_min = settings->yMin;
+    plot_data.range_y_max = settings->yMax;
+    return true;
+}
+
+// Draws a single series with the bounds already set in settings.
+static bool DrawSeriesPlot(const std::string& filename,
+    ScatterPlotSettings* settings, ScatterPlotSeries *series)
+{
+    settings->scatterPlotSeries->push_back(series);
+    ClearPlotSeries();
+
+    StringReference *errorMessage = &context_.error;
+    bool success = DrawPlotFrame(&plot_canvas, settings, errorMessage)
+        && AmendScatterPlotFromSettings(&plot_canvas, settings, errorMessage);
+    MarkPlotRedrawn();
 
     if (success)
     {
-        std::vector<double> *pngdata = ConvertToPNG(imageReference->image);
-        WriteToFile(pngdata, filename);
-        DeleteImage(imageReference->image);
+        success = ExportCanvas(filename, plot_canvas);
     }
 
     return success;
 }
 
+bool GeneratePlot(const std::string& filename, ScatterPlotSeries *series) {
+
+    ScatterPlotSettings* settings = ResetSettings(plot_data.plot_name);
+
+    CalculateBounds(settings, series);
+
+    return DrawSeriesPlot(filename, settings, series);
+}
+
+bool GeneratePlotInRange(const std::string& filename, ScatterPlotSeries *series,
+    double xmin, double xmax, double ymin, double ymax) {
+
+    ScatterPlotSettings* settings = ResetSettings(plot_data.plot_name);
+
+    CalculateBoundsInRange(settings, series, xmin, xmax, ymin, ymax);
+
+    return DrawSeriesPlot(filename, settings, series);
+}
+
+bool GeneratePlotFromPyramid(const std::string& filename, const MinMaxPyramid& pyramid)
+{
+    if (pyramid.count == 0)
+        return false;
+
+    double xmin = pyramid.xs[0];
+    double xmax = pyramid.xs[pyramid.count - 1];
+
+    // zoom into the ranges picked with the 'x' and 'y' keys
+    if (plot_data.user_range_x[1] > plot_data.user_range_x[0])
+    {
+        xmin = plot_data.user_range_x[0];
+        xmax = plot_data.user_range_x[1];
+    }
+
+    double ymin = 0.0;
+    double ymax = 0.0;
+    if (plot_data.user_range_y[1] > plot_data.user_range_y[0])
+    {
+        ymin = plot_data.user_range_y[0];
+        ymax = plot_data.user_range_y[1];
+    }
+
+    uint32_t columns = plot_data.pix_x - plot_data.pad_x * 2;
+
+    ScatterPlotSeries *series = NewLineSeries(0);
+    DecimateRange(pyramid, xmin, xmax, columns, series->xs, series->ys);
+
+    return GeneratePlotInRange(filename, series, xmin, xmax, ymin, ymax);
+}
+
 bool GenerateEmptyPlot(const std::string& filename) {
 
-    ScatterPlotSettings* settings = GetDefaultScatterPlotSettings();
+    ScatterPlotSettings* settings = ResetSettings(L"Empty");
 
     settings->xMin = plot_data.range_x_min;
     settings->xMax = plot_data.range_x_max;
     settings->yMin = plot_data.range_y_min;
     settings->yMax = plot_data.range_y_max;
+    ClearPlotSeries();
 
-    settings->width = plot_data.pix_x;
-    settings->height = plot_data.pix_y;
-    settings->autoBoundaries = false;
-    settings->autoPadding = false;
-    settings->xPadding=plot_data.pad_x;
-    settings->yPadding=plot_data.pad_y;
-    settings->title = new_vec_char(L"Empty");
-    settings->xLabel = new_vec_char(L"X axis");
-    settings->yLabel = new_vec_char(L"Y axis");
-
-    RGBABitmapImageReference* imageReference = CreateRGBABitmapImageReference();
-    StringReference *errorMessage = new StringReference();
-    bool success = DrawScatterPlotFromSettings(imageReference, settings, errorMessage);
+    StringReference *errorMessage = &context_.error;
+    bool success = DrawPlotFrame(&plot_canvas, settings, errorMessage);
+    MarkPlotRedrawn();
 
     if (success)
     {
-        std::vector<double> *pngdata = ConvertToPNG(imageReference->image);
-        WriteToFile(pngdata, filename);
-        DeleteImage(imageReference->image);
+        success = ExportCanvas(filename, plot_canvas);
     }
 
     return success;
 }
 
+bool RedrawPlotFrame(double xmin, double xmax, double ymin, double ymax)
+{
+    ScatterPlotSettings* settings = ResetSettings(plot_data.plot_name);
+
+    // the title is the one of the last frame, which plot_name may no longer be
+    if (context_.frame_valid)
+        context_.title = context_.frame_title;
+
+    settings->xMin = xmin;
+    settings->xMax = xmax;
+    settings->yMin = ymin;
+    settings->yMax = ymax;
+
+    plot_data.range_x_min = xmin;
+    plot_data.range_x_max = xmax;
+    plot_data.range_y_min = ymin;
+    plot_data.range_y_max = ymax;
+
+    const bool success = DrawPlotFrame(&plot_canvas, settings, &context_.error);
+    MarkPlotRedrawn();
+    return success;
+}
+
 bool GenerateSimplePlot(const std::string& filename, std::vector<double>& xs,
                         std::vector<double>& ys)
 {
 
-    RGBABitmapImageReference* imageReference = CreateRGBABitmapImageReference();
+    RGBABitmapImageReference imageReference;
+    imageReference.image = nullptr;
 
-    StringReference* errorMessage = new StringReference();
+    StringReference* errorMessage = &context_.error;
 
-    bool success = DrawScatterPlot(imageReference, plot_data.pix_x,
+    // pbPlots draws the series into the image itself here
+    ClearPlotSeries();
+
+    bool success = DrawScatterPlot(&imageReference, plot_data.pix_x,
                                    plot_data.pix_y, &xs, &ys, errorMessage);
 
     if (success)
     {
-        std::vector<double>* pngdata = ConvertToPNG(imageReference->image);
-        WriteToFile(pngdata, filename);
-        DeleteImage(imageReference->image);
+        success = CanvasFromImage(&plot_canvas, imageReference.image);
+        MarkPlotRedrawn();
+        success = success && ExportCanvas(filename, plot_canvas);
+        DeleteImage(imageReference.image);
     }
 
     return success;
@@ -201,32 +499,42 @@ struct Rectangle{
 void CompBoundariesBasedOnSettings(ScatterPlotSettings *settings, Rectangle *boundaries){
     ScatterPlotSeries *sp;
     double plot, xMin, xMax, yMin, yMax;
-
-    if(settings->scatterPlotSeries->size() >= 1.0){
-        xMin = GetMinimum(settings->scatterPlotSeries->at(0)->xs);
-        xMax = GetMaximum(settings->scatterPlotSeries->at(0)->xs);
-        yMin = GetMinimum(settings->scatterPlotSeries->at(0)->ys);
-        yMax = GetMaximum(settings->scatterPlotSeries->at(0)->ys);
-    }else{
-        xMin =  -10.0;
-        xMax = 10.0;
-        yMin =  -10.0;
-        yMax = 10.0;
-    }
+    MinMax x, y;
 
     if( !settings->autoBoundaries ){
         xMin = settings->xMin;
         xMax = settings->xMax;
         yMin = settings->yMin;
         yMax = settings->yMax;
+    }else if(settings->scatterPlotSeries->empty()){
+        xMin =  -10.0;
+        xMax = 10.0;
+        yMin =  -10.0;
+        yMax = 10.0;
     }else{
-        for(plot = 1.0; plot < settings->scatterPlotSeries->size(); plot = plot + 1.0){
+        /* One fused min/max pass per array, series without finite values do not count. */
+        xMin = INFINITY;
+        xMax = -INFINITY;
+        yMin = INFINITY;
+        yMax = -INFINITY;
+        for(plot = 0.0; plot < settings->scatterPlotSeries->size(); plot = plot + 1.0){
             sp = settings->scatterPlotSeries->at(plot);
 
-            xMin = fmin(xMin, GetMinimum(sp->xs));
-            xMax = fmax(xMax, GetMaximum(sp->xs));
-            yMin = fmin(yMin, GetMinimum(sp->ys));
-            yMax = fmax(yMax, GetMaximum(sp->ys));
+            x = FindMinMax(sp->xs->data(), sp->xs->size());
+            y = FindMinMax(sp->ys->data(), sp->ys->size());
+            xMin = fmin(xMin, x.min);
+            xMax = fmax(xMax, x.max);
+            yMin = fmin(yMin, y.min);
+            yMax = fmax(yMax, y.max);
+        }
+
+        if(xMin > xMax){
+            xMin = -10.0;
+            xMax = 10.0;
+        }
+        if(yMin > yMax){
+            yMin = -10.0;
+            yMax = 10.0;
         }
     }
 
@@ -236,28 +544,235 @@ void CompBoundariesBasedOnSettings(ScatterPlotSettings *settings, Rectangle *bou
     boundaries->y2 = yMax;
 }
 
-bool AmendScatterPlotFromSettings(RGBABitmapImageReference *canvasReference, ScatterPlotSettings *settings, StringReference *errorMessage){
-    double xMin, xMax, yMin, yMax, xLength, yLength, i, x, y, xPrev, yPrev, px, py, pxPrev, pyPrev, originX, originY, p, l, plot;
+// Whether both settings lead pbPlots to draw the same frame.
+bool SameFrame(const ScatterPlotSettings *a, const ScatterPlotSettings *b){
+    return a->width == b->width && a->height == b->height
+        && a->autoBoundaries == b->autoBoundaries
+        && a->xMin == b->xMin && a->xMax == b->xMax && a->yMin == b->yMin && a->yMax == b->yMax
+        && a->autoPadding == b->autoPadding && a->xPadding == b->xPadding && a->yPadding == b->yPadding
+        && a->showGrid == b->showGrid
+        && a->xAxisAuto == b->xAxisAuto && a->xAxisTop == b->xAxisTop && a->xAxisBottom == b->xAxisBottom
+        && a->yAxisAuto == b->yAxisAuto && a->yAxisLeft == b->yAxisLeft && a->yAxisRight == b->yAxisRight
+        && *a->title == *b->title && *a->xLabel == *b->xLabel && *a->yLabel == *b->yLabel;
+}
+
+// Draws title, labels, axes and grid with pbPlots and converts the result
+// into the packed canvas. The series themselves are left out and drawn
+// afterwards by AmendScatterPlotFromSettings, so the double-per-channel
+// pbPlots image only lives for the duration of this call. A replot with the
+// same frame reuses the previous one without calling pbPlots at all.
+bool DrawPlotFrame(Canvas *canvas, ScatterPlotSettings *settings, StringReference *errorMessage){
+    std::vector<ScatterPlotSeries*> noSeries;
+    std::vector<ScatterPlotSeries*> *series = settings->scatterPlotSeries;
+    RGBABitmapImageReference imageReference;
+    PlotContext &c = context_;
+    bool success;
+
+    if(c.frame_valid && SameFrame(settings, &c.frame_settings)){
+        *canvas = c.frame;
+        return true;
+    }
+
+    imageReference.image = nullptr;
+    settings->scatterPlotSeries = &noSeries;
+    success = DrawScatterPlotFromSettings(&imageReference, settings, errorMessage);
+    settings->scatterPlotSeries = series;
+
+    if(success){
+        success = CanvasFromImage(canvas, imageReference.image);
+        DeleteImage(imageReference.image);
+    }
+
+    c.frame_valid = success;
+    if(success){
+        c.frame = *canvas;
+        c.frame_title = *settings->title;
+        c.frame_x_label = *settings->xLabel;
+        c.frame_y_label = *settings->yLabel;
+        c.frame_settings = *settings;
+        c.frame_settings.title = &c.frame_title;
+        c.frame_settings.xLabel = &c.frame_x_label;
+        c.frame_settings.yLabel = &c.frame_y_label;
+        c.frame_settings.scatterPlotSeries = nullptr;
+    }
+
+    return success;
+}
+
+enum class LineStyle { None, Solid, Dashed, Dotted, DotDash, LongDash, TwoDash };
+enum class PointStyle { None, Crosses, Circles, Dots, Triangles, FilledTriangles, Pixels };
+
+bool StyleIs(const std::vector<wchar_t> *style, const wchar_t *name){
+    return style != nullptr && std::wstring(style->begin(), style->end()) == name;
+}
+
+LineStyle ResolveLineStyle(const std::vector<wchar_t> *lineType){
+    if(StyleIs(lineType, L"solid")) return LineStyle::Solid;
+    if(StyleIs(lineType, L"dashed")) return LineStyle::Dashed;
+    if(StyleIs(lineType, L"dotted")) return LineStyle::Dotted;
+    if(StyleIs(lineType, L"dotdash")) return LineStyle::DotDash;
+    if(StyleIs(lineType, L"longdash")) return LineStyle::LongDash;
+    if(StyleIs(lineType, L"twodash")) return LineStyle::TwoDash;
+    return LineStyle::None;
+}
+
+PointStyle ResolvePointStyle(const std::vector<wchar_t> *pointType){
+    if(StyleIs(pointType, L"crosses")) return PointStyle::Crosses;
+    if(StyleIs(pointType, L"circles")) return PointStyle::Circles;
+    if(StyleIs(pointType, L"dots")) return PointStyle::Dots;
+    if(StyleIs(pointType, L"triangles")) return PointStyle::Triangles;
+    if(StyleIs(pointType, L"filled triangles")) return PointStyle::FilledTriangles;
+    if(StyleIs(pointType, L"pixels")) return PointStyle::Pixels;
+    return PointStyle::None;
+}
+
+// pbPlots allocates a new pattern on every GetLinePatternN call, so each one
+// is fetched once and kept for the rest of the program.
+const std::vector<bool>& LinePattern(LineStyle style){
+    static const std::vector<bool> *patterns[] = {
+        GetLinePattern1(), GetLinePattern2(), GetLinePattern3(),
+        GetLinePattern4(), GetLinePattern5(),
+    };
+
+    switch(style){
+    case LineStyle::Dashed: return *patterns[0];
+    case LineStyle::Dotted: return *patterns[1];
+    case LineStyle::DotDash: return *patterns[2];
+    case LineStyle::LongDash: return *patterns[3];
+    default: return *patterns[4];
+    }
+}
+
+// The marker drawn for a point style, false for none.
+bool MarkerShape(PointStyle style, RasterShape *shape){
+    switch(style){
+    case PointStyle::Crosses: *shape = RasterShape::Cross; return true;
+    case PointStyle::Circles: *shape = RasterShape::Circle; return true;
+    case PointStyle::Dots: *shape = RasterShape::FilledCircle; return true;
+    case PointStyle::Triangles: *shape = RasterShape::Triangle; return true;
+    case PointStyle::FilledTriangles: *shape = RasterShape::FilledTriangle; return true;
+    case PointStyle::Pixels: *shape = RasterShape::Pixel; return true;
+    default: return false;
+    }
+}
+
+// Passes the pixel position of every point strictly inside the plot area to
+// drawPoint(x, y).
+template <typename DrawPoint>
+void ForEachPoint(const PixelTransform& t, const std::vector<double> *xs, const std::vector<double> *ys, DrawPoint drawPoint){
+    const size_t n = std::min(xs->size(), ys->size());
+    double x, y;
+    size_t i;
+
+    for(i = 0; i < n; i++){
+        x = (*xs)[i]*t.x_scale + t.x_offset;
+        y = (*ys)[i]*t.y_scale + t.y_offset;
+
+        if(x > t.x_min && x < t.x_max && y > t.y_min && y < t.y_max){
+            drawPoint(floor(x), floor(y));
+        }
+    }
+}
+
+// Records a line series with its style resolved once, one loop per style.
+void AddLineSeries(RasterList *raster, const PixelTransform& t, const std::vector<double> *xs, const std::vector<double> *ys,
+    LineStyle style, double thickness, Color8 color, double *patternOffset){
+    uint32_t rasterStyle;
+
+    if(style == LineStyle::None){
+        return;
+    }
+
+    if(style == LineStyle::Solid){
+        rasterStyle = RasterAddStyle(raster, color, thickness);
+    }else{
+        rasterStyle = RasterAddStyle(raster, color, thickness, &LinePattern(style));
+    }
+
+    std::vector<PixelSegment> *segments = &context_.segments;
+    ClipPolyline(xs->data(), ys->data(), std::min(xs->size(), ys->size()), t, &context_.pixel_points, segments);
+    RasterAddLines(raster, rasterStyle, segments->data(), segments->size(), patternOffset);
+}
+
+// Records a series into list for drawing on the GPU, in place of AddLineSeries
+// or AddPointSeries.
+void RecordSeries(PlotSeriesList *list, const ScatterPlotSeries *sp){
+    const size_t n = std::min(sp->xs->size(), sp->ys->size());
+    LineStyle lineStyle = LineStyle::None;
+    RasterShape marker = RasterShape::Pixel;
+    PlotSeries *s;
+    size_t i;
+
+    if(sp->linearInterpolation){
+        lineStyle = ResolveLineStyle(sp->lineType);
+        if(lineStyle == LineStyle::None){
+            return;
+        }
+    }else if(!MarkerShape(ResolvePointStyle(sp->pointType), &marker)){
+        return;
+    }
+
+    list->series.emplace_back();
+    list->version++;
+    s = &list->series.back();
+    s->lines = sp->linearInterpolation;
+    s->size = s->lines ? sp->lineThickness : 6.0;
+    if(s->lines){
+        s->pattern = lineStyle == LineStyle::Solid ? nullptr : &LinePattern(lineStyle);
+    }else{
+        s->marker = marker;
+    }
+    s->rgb[0] = sp->color->r;
+    s->rgb[1] = sp->color->g;
+    s->rgb[2] = sp->color->b;
+
+    s->xy.resize(n*2);
+    for(i = 0; i < n; i++){
+        s->xy[i*2] = (float)((*sp->xs)[i] - list->origin_x);
+        s->xy[i*2 + 1] = (float)((*sp->ys)[i] - list->origin_y);
+    }
+}
+
+// Records the markers of a point series with its style resolved once.
+void AddPointSeries(RasterList *raster, const PixelTransform& t, const std::vector<double> *xs, const std::vector<double> *ys,
+    PointStyle style, Color8 color){
+    RasterShape shape;
+    uint32_t rasterStyle;
+
+    if(!MarkerShape(style, &shape)){
+        return;
+    }
+
+    rasterStyle = RasterAddStyle(raster, color, 1.0);
+    ForEachPoint(t, xs, ys, [&](double x, double y){
+        RasterAddMarker(raster, rasterStyle, shape, x, y, 3);
+    });
+}
+
+bool AmendScatterPlotFromSettings(Canvas *canvas, ScatterPlotSettings *settings, StringReference *errorMessage, CanvasClip *dirty){
+    double xMin, xMax, yMin, yMax, xLength, yLength, originX, originY, p, l, plot;
     Rectangle boundaries;
     double xPadding, yPadding, originXPixels, originYPixels;
     double xPixelMin, yPixelMin, xPixelMax, yPixelMax, xLengthPixels, yLengthPixels, axisLabelPadding;
-    NumberReference nextRectangle, x1Ref, y1Ref, x2Ref, y2Ref, patternOffset;
-    bool prevSet, success;
+    NumberReference nextRectangle;
+    PixelTransform transform;
+    double patternOffset;
+    bool success;
     RGBA *gridLabelColor;
-    RGBABitmapImage *canvas;
+    Color8 color;
     std::vector<double> *xs, *ys;
+    std::vector<double> *decimatedXs = &context_.decimated_xs, *decimatedYs = &context_.decimated_ys;
+    double xScale, xOffset;
     bool linearInterpolation;
     ScatterPlotSeries *sp;
     std::vector<double> *xGridPositions, *yGridPositions;
     StringArrayReference *xLabels, *yLabels;
     NumberArrayReference *xLabelPriorities, *yLabelPriorities;
     std::vector<Rectangle*> *occupied;
-    std::vector<bool> *linePattern;
     bool originXInside, originYInside, textOnLeft, textOnBottom;
     double originTextX, originTextY, originTextXPixels, originTextYPixels, side;
 
-    canvas = canvasReference->image;
-    patternOffset.numberValue=0.0;
+    patternOffset=0.0;
 
     success = ScatterPlotFromSettingsValid(settings, errorMessage);
 
@@ -350,99 +865,53 @@ bool AmendScatterPlotFromSettings(RGBABitmapImageReference *canvasReference, Sca
         }
         originTextXPixels = MapXCoordinate(originTextX, xMin, xMax, xPixelMin, xPixelMax);
 
+        transform = MakePixelTransform(xMin, xMax, yMin, yMax, xPixelMin, xPixelMax, yPixelMin, yPixelMax);
+
+        if(plot_data.gpu_series){
+            /* Series added to a continuous plot keep the origin of the first one. */
+            if(plot_series.series.empty()){
+                plot_series.origin_x = xMin + xLength/2.0;
+                plot_series.origin_y = yMin + yLength/2.0;
+            }
+            plot_series.transform = transform;
+            plot_series.width = (uint32_t)settings->width;
+            plot_series.height = (uint32_t)settings->height;
+        }
+
         /* Draw points */
         for(plot = 0.0; plot < settings->scatterPlotSeries->size(); plot = plot + 1.0){
             sp = settings->scatterPlotSeries->at(plot);
 
+            /* The GPU gets the full series and is free to zoom into it later. */
+            if(plot_data.gpu_series){
+                RecordSeries(&plot_series, sp);
+                continue;
+            }
+
             xs = sp->xs;
             ys = sp->ys;
             linearInterpolation = sp->linearInterpolation;
+            color = ToColor8(sp->color);
+
+            /* Large solid line series are cut down to a few points per pixel column first, see DecimateM4.
+               Patterned ones are left as they are, decimating them would shift their dashes. */
+            if(linearInterpolation && ResolveLineStyle(sp->lineType) == LineStyle::Solid && xs->size() > DECIMATION_POINTS_PER_COLUMN*xLengthPixels){
+                xScale = xLengthPixels/xLength;
+                xOffset = xPixelMin - xMin*xScale;
+                DecimateM4(xs->data(), ys->data(), std::min(xs->size(), ys->size()), xScale, xOffset, decimatedXs, decimatedYs);
+                xs = decimatedXs;
+                ys = decimatedYs;
+            }
 
             if(linearInterpolation){
-                prevSet = false;
-                xPrev = 0.0;
-                yPrev = 0.0;
-                for(i = 0.0; i < xs->size(); i = i + 1.0){
-                    x = xs->at(i);
-                    y = ys->at(i);
-
-                    if(prevSet){
-                        x1Ref.numberValue = xPrev;
-                        y1Ref.numberValue = yPrev;
-                        x2Ref.numberValue = x;
-                        y2Ref.numberValue = y;
-
-                        success = CropLineWithinBoundary(&x1Ref, &y1Ref, 
-                            &x2Ref, &y2Ref, xMin, xMax, yMin, yMax);
-
-                        if(success){
-                            pxPrev = floor(MapXCoordinate(x1Ref.numberValue, xMin, xMax, xPixelMin, xPixelMax));
-                            pyPrev = floor(MapYCoordinate(y1Ref.numberValue, yMin, yMax, yPixelMin, yPixelMax));
-                            px = floor(MapXCoordinate(x2Ref.numberValue, xMin, xMax, xPixelMin, xPixelMax));
-                            py = floor(MapYCoordinate(y2Ref.numberValue, yMin, yMax, yPixelMin, yPixelMax));
-
-                            if(aStringsEqual(sp->lineType, toVector(L"solid")) && sp->lineThickness == 1.0){
-                                DrawLine1px(canvas, pxPrev, pyPrev, px, py, sp->color);
-                            }else if(aStringsEqual(sp->lineType, toVector(L"solid"))){
-                                DrawLine(canvas, pxPrev, pyPrev, px, py, sp->lineThickness, sp->color);
-                            }else if(aStringsEqual(sp->lineType, toVector(L"dashed"))){
-                                linePattern = GetLinePattern1();
-                                DrawLineBresenhamsAlgorithmThickPatterned(canvas, pxPrev, pyPrev, px, py, sp->lineThickness, linePattern, &patternOffset, sp->color);
-                            }else if(aStringsEqual(sp->lineType, toVector(L"dotted"))){
-                                linePattern = GetLinePattern2();
-                                DrawLineBresenhamsAlgorithmThickPatterned(canvas, pxPrev, pyPrev, px, py, sp->lineThickness, linePattern, &patternOffset, sp->color);
-                            }else if(aStringsEqual(sp->lineType, toVector(L"dotdash"))){
-                                linePattern = GetLinePattern3();
-                                DrawLineBresenhamsAlgorithmThickPatterned(canvas, pxPrev, pyPrev, px, py, sp->lineThickness, linePattern, &patternOffset, sp->color);
-                            }else if(aStringsEqual(sp->lineType, toVector(L"longdash"))){
-                                linePattern = GetLinePattern4();
-                                DrawLineBresenhamsAlgorithmThickPatterned(canvas, pxPrev, pyPrev, px, py, sp->lineThickness, linePattern, &patternOffset, sp->color);
-                            }else if(aStringsEqual(sp->lineType, toVector(L"twodash"))){
-                                linePattern = GetLinePattern5();
-                                DrawLineBresenhamsAlgorithmThickPatterned(canvas, pxPrev, pyPrev, px, py, sp->lineThickness, linePattern, &patternOffset, sp->color);
-                            }
-                        }
-                    }
-
-                    prevSet = true;
-                    xPrev = x;
-                    yPrev = y;
-                }
+                AddLineSeries(&context_.raster, transform, xs, ys, ResolveLineStyle(sp->lineType), sp->lineThickness, color, &patternOffset);
             }else{
-                for(i = 0.0; i < xs->size(); i = i + 1.0){
-                    x = xs->at(i);
-                    y = ys->at(i);
-
-                    if(x > xMin && x < xMax && y > yMin && y < yMax){
-
-                        x = floor(MapXCoordinate(x, xMin, xMax, xPixelMin, xPixelMax));
-                        y = floor(MapYCoordinate(y, yMin, yMax, yPixelMin, yPixelMax));
-
-                        if(aStringsEqual(sp->pointType, toVector(L"crosses"))){
-                            DrawPixel(canvas, x, y, sp->color);
-                            DrawPixel(canvas, x + 1.0, y, sp->color);
-                            DrawPixel(canvas, x + 2.0, y, sp->color);
-                            DrawPixel(canvas, x - 1.0, y, sp->color);
-                            DrawPixel(canvas, x - 2.0, y, sp->color);
-                            DrawPixel(canvas, x, y + 1.0, sp->color);
-                            DrawPixel(canvas, x, y + 2.0, sp->color);
-                            DrawPixel(canvas, x, y - 1.0, sp->color);
-                            DrawPixel(canvas, x, y - 2.0, sp->color);
-                        }else if(aStringsEqual(sp->pointType, toVector(L"circles"))){
-                            DrawCircle(canvas, x, y, 3.0, sp->color);
-                        }else if(aStringsEqual(sp->pointType, toVector(L"dots"))){
-                            DrawFilledCircle(canvas, x, y, 3.0, sp->color);
-                        }else if(aStringsEqual(sp->pointType, toVector(L"triangles"))){
-                            DrawTriangle(canvas, x, y, 3.0, sp->color);
-                        }else if(aStringsEqual(sp->pointType, toVector(L"filled triangles"))){
-                            DrawFilledTriangle(canvas, x, y, 3.0, sp->color);
-                        }else if(aStringsEqual(sp->pointType, toVector(L"pixels"))){
-                            DrawPixel(canvas, x, y, sp->color);
-                        }
-                    }
-                }
+                AddPointSeries(&context_.raster, transform, xs, ys, ResolvePointStyle(sp->pointType), color);
             }
         }
+
+        /* All series are recorded first and then rasterized together, in tiles spread over the worker pool. */
+        RasterDraw(canvas, &context_.raster, dirty);
     }
 
     return success;
@@ -450,60 +919,391 @@ bool AmendScatterPlotFromSettings(RGBABitmapImageReference *canvasReference, Sca
 
 }
 
-static RGBABitmapImageReference* gimageReference=nullptr;
 bool ContinuousPlot(const std::string& filename, ScatterPlotSeries *series) {
 
-    ScatterPlotSettings* settings = GetDefaultScatterPlotSettings();
+    ScatterPlotSettings* settings = ResetSettings(plot_data.plot_name);
 
     settings->xMin = plot_data.range_x_min;
     settings->xMax = plot_data.range_x_max;
     settings->yMin = plot_data.range_y_min;
     settings->yMax = plot_data.range_y_max;
+    settings->scatterPlotSeries->push_back(series);
 
-    settings->width = plot_data.pix_x;
-    settings->height = plot_data.pix_y;
-    settings->autoBoundaries = false;
-    settings->autoPadding = false;
-    settings->xPadding=plot_data.pad_x;
-    settings->yPadding=plot_data.pad_y;
-    settings->title = new_vec_char(plot_data.plot_name);
-    settings->xLabel = new_vec_char(L"X axis");
-    settings->yLabel = new_vec_char(L"Y axis");
-    settings->scatterPlotSeries = new std::vector<ScatterPlotSeries*> {series};
+    bool firstInLine = gcanvas.rgba.empty();
 
-    bool firstInLine=false;
-    if(!gimageReference)
+    StringReference *errorMessage = &context_.error;
+    bool success = true;
+
+    if (firstInLine)
     {
-        gimageReference = CreateRGBABitmapImageReference();
-        gimageReference->image = CreateImage(settings->width, settings->height, GetWhite());
+        ClearPlotSeries();
+        success = DrawPlotFrame(&gcanvas, settings, errorMessage);
+    }
 
-        firstInLine=true;
+    // only the pixels the new series drew are passed on, when plot_canvas
+    // shows this continuous plot already
+    CanvasClip changed;
+    if (success)
+    {
+        success = AmendScatterPlotFromSettings(&gcanvas, settings, errorMessage, &changed);
     }
 
-    StringReference *errorMessage = new StringReference();
-    bool success = false;
+    if (success)
+    {
+        if (firstInLine || plot_canvas_source_ != &gcanvas)
+        {
+            plot_canvas = gcanvas;
+            MarkPlotRedrawn(&gcanvas);
+        }
+        else
+        {
+            CanvasCopyRect(&plot_canvas, gcanvas, changed);
+            MarkPlotDirty(changed);
+        }
+        success = ExportCanvas(filename, plot_canvas);
+    }
 
-    if (firstInLine)
+    return success;
+}
+
+void FinishContinuousPlot()
+{
+    // clear() keeps the capacity for the next continuous plot
+    gcanvas.rgba.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Live plot
+
+namespace {
+
+// Share of the window the x range scrolls by at once, and of the y range
+// added as room when samples leave it.
+const uint32_t LIVE_SCROLL_STEPS = 8;
+const double LIVE_Y_MARGIN = 0.1;
+
+// State of the live plot from BeginLivePlot to FinishLivePlot.
+struct LivePlot
+{
+    bool active = false;
+
+    // the x range is [x_min, x_min + window], moved to the first sample
+    double window = 0.0;
+    double x_min = 0.0;
+    double y_min = 0.0;
+    double y_max = 0.0;
+    bool anchored = false;
+
+    // plot area in whole pixels, inclusive, and the columns of one scroll
+    int area_x0 = 0;
+    int area_y0 = 0;
+    int area_x1 = 0;
+    int area_y1 = 0;
+    uint32_t step_columns = 1;
+    PixelTransform transform;
+
+    // frame of the current range, and the series drawn so far on an
+    // otherwise transparent canvas of the same size
+    Canvas frame;
+    Canvas layer;
+
+    std::vector<wchar_t> line_type;
+    Color8 color;
+    double pattern_offset = 0.0;
+
+    // the series within the window as drawn, M4 decimated if solid, for
+    // drawing it again when the y range grows; its last point starts the
+    // next segment
+    std::vector<double> xs;
+    std::vector<double> ys;
+
+    std::vector<double> scratch_xs;
+    std::vector<double> scratch_ys;
+};
+
+thread_local LivePlot live_;
+
+// Draws the frame of the current range and sets the transform onto it.
+bool DrawLiveFrame()
+{
+    LivePlot& l = live_;
+    ScatterPlotSettings* settings = ResetSettings(plot_data.plot_name);
+
+    settings->xMin = l.x_min;
+    settings->xMax = l.x_min + l.window;
+    settings->yMin = l.y_min;
+    settings->yMax = l.y_max;
+
+    // clicks map to the range on screen
+    plot_data.range_x_min = settings->xMin;
+    plot_data.range_x_max = settings->xMax;
+    plot_data.range_y_min = settings->yMin;
+    plot_data.range_y_max = settings->yMax;
+
+    l.transform = MakePixelTransform(settings->xMin, settings->xMax, l.y_min,
+                                     l.y_max, plot_data.pad_x,
+                                     plot_data.pix_x - plot_data.pad_x,
+                                     plot_data.pad_y,
+                                     plot_data.pix_y - plot_data.pad_y);
+
+    return DrawPlotFrame(&l.frame, settings, &context_.error);
+}
+
+// Rasterizes the polyline through xs/ys onto the layer, continuing the
+// line pattern from the last call, and grows dirty by what it drew.
+void DrawLiveLine(const std::vector<double>* xs, const std::vector<double>* ys,
+    CanvasClip* dirty)
+{
+    LivePlot& l = live_;
+
+    AddLineSeries(&context_.raster, l.transform, xs, ys,
+                  ResolveLineStyle(&l.line_type), 2.0, l.color,
+                  &l.pattern_offset);
+    RasterDraw(&l.layer, &context_.raster, dirty);
+}
+
+// Moves everything on the layer left by the given number of columns.
+void ScrollLiveLayer(double columns)
+{
+    Canvas& c = live_.layer;
+    const size_t row = (size_t)c.width * 4;
+    const size_t shift = (size_t)std::min(columns, (double)c.width) * 4;
+
+    for (uint32_t y = 0; y < c.height; y++)
     {
-        success = DrawScatterPlotFromSettings(gimageReference, settings, errorMessage);
+        uint8_t* p = c.rgba.data() + y * row;
+        std::memmove(p, p + shift, row - shift);
+        std::memset(p + row - shift, 0, shift);
     }
-    else {
-        success = AmendScatterPlotFromSettings(gimageReference, settings, errorMessage);
+}
+
+// Drops the points left of the window, but the last of them, which the
+// line into the window starts from.
+void TrimLiveHistory()
+{
+    LivePlot& l = live_;
+    const size_t keep = std::find_if(l.xs.begin(), l.xs.end(),
+        [&](double x) { return x >= l.x_min; }) - l.xs.begin();
+
+    if (keep > 1)
+    {
+        l.xs.erase(l.xs.begin(), l.xs.begin() + keep - 1);
+        l.ys.erase(l.ys.begin(), l.ys.begin() + keep - 1);
     }
+}
 
+// plot_canvas is the frame with the layer over its plot area. The series
+// colors are opaque, so every pixel of the layer either covers the frame
+// or is left out. With the frame unchanged, and plot_canvas showing the
+// live plot already, only the layer pixels within changed are laid over it.
+void ComposeLivePlot(bool reframed, const CanvasClip& changed)
+{
+    const LivePlot& l = live_;
+    const size_t row = (size_t)l.frame.width * 4;
+    CanvasClip rect;
+    rect.x0 = l.area_x0;
+    rect.y0 = l.area_y0;
+    rect.x1 = l.area_x1;
+    rect.y1 = l.area_y1;
+
+    if (reframed || plot_canvas_source_ != &live_)
+    {
+        plot_canvas = l.frame;
+        MarkPlotRedrawn(&live_);
+    }
+    else
+    {
+        rect.x0 = std::max(rect.x0, changed.x0);
+        rect.y0 = std::max(rect.y0, changed.y0);
+        rect.x1 = std::min(rect.x1, changed.x1);
+        rect.y1 = std::min(rect.y1, changed.y1);
+        MarkPlotDirty(rect);
+    }
+
+    for (int y = rect.y0; y <= rect.y1; y++)
+    {
+        const uint8_t* src = l.layer.rgba.data() + y * row;
+        uint8_t* dst = plot_canvas.rgba.data() + y * row;
 
+        for (int x = rect.x0; x <= rect.x1; x++)
+        {
+            if (src[x * 4 + 3] != 0)
+                std::memcpy(dst + x * 4, src + x * 4, 4);
+        }
+    }
+}
 
-    if (success)
+}
+
+bool BeginLivePlot(double window)
+{
+    LivePlot& l = live_;
+
+    if (window <= 0.0 || plot_data.pix_x <= plot_data.pad_x * 2u
+        || plot_data.pix_y <= plot_data.pad_y * 2u)
+        return false;
+
+    l.window = window;
+    l.x_min = plot_data.range_x_min;
+    l.y_min = plot_data.range_y_min;
+    l.y_max = plot_data.range_y_max;
+    if (!(l.y_max > l.y_min))
+        l.y_max = l.y_min + 1.0;
+    l.anchored = false;
+
+    // clamped to the canvas, where a line in the last column is still drawn
+    l.area_x0 = plot_data.pad_x;
+    l.area_y0 = plot_data.pad_y;
+    l.area_x1 = std::min(plot_data.pix_x - plot_data.pad_x, plot_data.pix_x - 1);
+    l.area_y1 = std::min(plot_data.pix_y - plot_data.pad_y, plot_data.pix_y - 1);
+    l.step_columns = std::max(1u, (plot_data.pix_x - plot_data.pad_x * 2u)
+                                      / LIVE_SCROLL_STEPS);
+
+    RGBA color;
+    color.r = plot_data.rgb[0];
+    color.g = plot_data.rgb[1];
+    color.b = plot_data.rgb[2];
+    color.a = 1.0;
+    l.color = ToColor8(&color);
+    AssignText(&l.line_type, plot_data.line_type);
+    l.pattern_offset = 0.0;
+    l.xs.clear();
+    l.ys.clear();
+
+    Color8 transparent;
+    transparent.a = 0;
+    ResizeCanvas(&l.layer, plot_data.pix_x, plot_data.pix_y, transparent);
+
+    ClearPlotSeries();
+    l.active = DrawLiveFrame();
+    if (l.active)
+        ComposeLivePlot(true, CanvasClip());
+
+    return l.active;
+}
+
+bool AppendLivePlot(const double* xs, const double* ys, size_t count)
+{
+    LivePlot& l = live_;
+
+    if (!l.active)
+        return false;
+
+    // extent of the new samples
+    double x_last = -DBL_MAX;
+    double y_lo = DBL_MAX;
+    double y_hi = -DBL_MAX;
+    double x_first = 0.0;
+    bool any = false;
+
+    for (size_t i = 0; i < count; i++)
     {
-        std::vector<double> *pngdata = ConvertToPNG(gimageReference->image);
-        WriteToFile(pngdata, filename);
+        if (!std::isfinite(xs[i]) || !std::isfinite(ys[i]))
+            continue;
+        if (!any)
+            x_first = xs[i];
+        any = true;
+        x_last = std::max(x_last, xs[i]);
+        y_lo = std::min(y_lo, ys[i]);
+        y_hi = std::max(y_hi, ys[i]);
     }
+    if (!any)
+        return true;
 
-    return success;
+    bool reframe = false;
+    bool redraw = false;
+
+    if (!l.anchored)
+    {
+        l.anchored = true;
+        l.x_min = x_first;
+        reframe = true;
+    }
+
+    // the y range only grows, with room to spare so it does not on every
+    // batch
+    if (y_lo < l.y_min || y_hi > l.y_max)
+    {
+        const double margin = (std::max(y_hi, l.y_max)
+                               - std::min(y_lo, l.y_min)) * LIVE_Y_MARGIN;
+        if (y_lo < l.y_min)
+            l.y_min = y_lo - margin;
+        if (y_hi > l.y_max)
+            l.y_max = y_hi + margin;
+        reframe = true;
+        redraw = true;
+    }
+
+    // The window scrolls in whole steps of step_columns pixels, so the
+    // series drawn so far only has to be moved over on the layer.
+    if (x_last > l.x_min + l.window)
+    {
+        const double columns = l.transform.x_max - l.transform.x_min;
+        const double step = l.window * l.step_columns / columns;
+        const double steps = std::ceil((x_last - l.x_min - l.window) / step);
+
+        l.x_min += steps * step;
+        if (!redraw)
+            ScrollLiveLayer(steps * l.step_columns);
+        TrimLiveHistory();
+        reframe = true;
+    }
+
+    if (reframe && !DrawLiveFrame())
+        return false;
+
+    if (redraw)
+    {
+        std::fill(l.layer.rgba.begin(), l.layer.rgba.end(), 0);
+        l.pattern_offset = 0.0;
+        DrawLiveLine(&l.xs, &l.ys, nullptr);
+    }
+
+    // only the new segments are drawn, from the last point drawn on;
+    // patterned lines are not decimated, see DrawSeriesPlot
+    const bool solid = ResolveLineStyle(&l.line_type) == LineStyle::Solid;
+    if (solid)
+    {
+        DecimateM4(xs, ys, count, l.transform.x_scale, l.transform.x_offset,
+                   &l.scratch_xs, &l.scratch_ys);
+    }
+    else
+    {
+        l.scratch_xs.assign(xs, xs + count);
+        l.scratch_ys.assign(ys, ys + count);
+    }
+    const size_t from = l.xs.empty() ? 0 : l.xs.size() - 1;
+    l.xs.insert(l.xs.end(), l.scratch_xs.begin(), l.scratch_xs.end());
+    l.ys.insert(l.ys.end(), l.scratch_ys.begin(), l.scratch_ys.end());
+    l.scratch_xs.assign(l.xs.begin() + from, l.xs.end());
+    l.scratch_ys.assign(l.ys.begin() + from, l.ys.end());
+    CanvasClip changed;
+    DrawLiveLine(&l.scratch_xs, &l.scratch_ys, &changed);
+
+    // batches of a few points per column add up, merge them now and then;
+    // a patterned line only loses what has left the window
+    const double columns = l.area_x1 - l.area_x0 + 1;
+    if (!solid)
+    {
+        TrimLiveHistory();
+    }
+    else if (l.xs.size() > DECIMATION_POINTS_PER_COLUMN * 2 * columns)
+    {
+        DecimateM4(l.xs.data(), l.ys.data(), l.xs.size(), l.transform.x_scale,
+                   l.transform.x_offset, &l.scratch_xs, &l.scratch_ys);
+        l.xs.swap(l.scratch_xs);
+        l.ys.swap(l.scratch_ys);
+    }
+
+    ComposeLivePlot(reframe, changed);
+    return true;
 }
 
-void FinishContinuousPlot()
+bool FinishLivePlot(const std::string& filename)
 {
-    DeleteImage(gimageReference->image);
-    gimageReference=nullptr;
+    if (!live_.active)
+        return false;
+
+    live_.active = false;
+    return ExportCanvas(filename, plot_canvas);
 }
@@ -4,6 +4,11 @@
 #include <functional>
 #include <string>
 #include "pbPlots.hpp"
+#include "canvas.h"
+#include "sampler.h"
+#include "decimate.h"
+#include "clip.h"
+#include "raster.h"
 
 struct PlotData
 {
@@ -29,23 +34,171 @@ struct PlotData
     std::wstring plot_name=L"nothing";
 
     double rgb[3]={1.0, 1.0, 1.0};
+
+    // Sample generators on the worker pool. Only for generators that are
+    // safe to call from several threads at once.
+    bool parallel_sampling=false;
+
+    // format of the files written along with every plot, and their
+    // compression when that is PNG
+    ImageFormat image_format=ImageFormat::Auto;
+    PngLevel png_level=PngLevel::Fast;
+
+    // Leave the series out of the plot image and record them in plot_series
+    // instead, for drawing on the GPU. The image then only holds the frame,
+    // which also goes for the files written along with it.
+    bool gpu_series=false;
+};
+
+// A series of the last plot, as recorded for plot_data.gpu_series. The
+// points are x, y pairs relative to the origin of the list, in float so
+// they upload to a vertex buffer as they are.
+struct PlotSeries
+{
+    std::vector<float> xy;
+    float rgb[3]={0.f, 0.f, 0.f};
+    float size=1.f;
+    bool lines=true;
+
+    // for rasterizing the series again (see series_tiles.h): the dash pattern of
+    // a line, null when solid, and the marker drawn for each point
+    const std::vector<bool>* pattern=nullptr;
+    RasterShape marker=RasterShape::Pixel;
 };
 
-extern PlotData plot_data;
+struct PlotSeriesList
+{
+    // maps plot coordinates to pixels of the plot image, which is
+    // width x height; its x/y_min/max are the plot area
+    PixelTransform transform;
+    uint32_t width=0;
+    uint32_t height=0;
+
+    // subtracted from every point, so large coordinates keep their
+    // precision in float
+    double origin_x=0.0;
+    double origin_y=0.0;
+
+    std::vector<PlotSeries> series;
+
+    // changes whenever the series do
+    uint64_t version=0;
+};
+
+// The plot state below, like all objects the plotter reuses between plots,
+// is per thread, so batch jobs (see batch.h) can render on several worker
+// threads at once.
+extern thread_local PlotData plot_data;
+
+// Last rendered plot, kept in memory for direct texture upload.
+extern thread_local Canvas plot_canvas;
+
+// Pixels of plot_canvas changed since the texture was last brought up to
+// date. A plot drawn anew marks all of it, while ContinuousPlot and the live
+// plot only mark what they drew; whoever uploads resets it to CanvasClip().
+extern thread_local CanvasClip plot_dirty;
+
+// Series of the last plot when plot_data.gpu_series is set, empty otherwise.
+extern thread_local PlotSeriesList plot_series;
+
+// Line series styled from plot_data, with xs/ys sized for count points that
+// the caller fills in place. The series and its storage belong to the
+// plotter and are reused by the next NewLineSeries call, so it must not be
+// deleted.
+ScatterPlotSeries* NewLineSeries(size_t count);
+
+// Bytes held by the plotter's reusable objects and canvases.
+size_t PlotContextBytes();
 
 bool GeneratePlotFromFunc(const std::string& filename, 
     const std::function<double(double)> & gen, const uint32_t & num, double xmin, double xmax);
 bool GenerateContinuousPlotFromFunc(const std::string& filename, 
     const std::function<double(double)> & gen, const uint32_t & num, double xmin, double xmax);
+bool GeneratePlotFromFuncAdaptive(const std::string& filename,
+    const std::function<double(double)> & gen, const AdaptiveSampling & sampling, double xmin, double xmax);
+bool GenerateContinuousPlotFromFuncAdaptive(const std::string& filename,
+    const std::function<double(double)> & gen, const AdaptiveSampling & sampling, double xmin, double xmax);
     bool GeneratePlotFromPoints(const std::string& filename, 
     const std::vector<double> &xs, const std::vector<double> &ys);
 bool GeneratePlot(const std::string& filename, ScatterPlotSeries *series);
+// x bounds fixed to [xmin, xmax]; y bounds from the data unless ymin < ymax
+bool GeneratePlotInRange(const std::string& filename, ScatterPlotSeries *series,
+    double xmin, double xmax, double ymin = 0.0, double ymax = 0.0);
+// Plots the user selected x/y range of a large data set (or all of it) by
+// reading only the pyramid summaries that cover the visible pixel columns.
+bool GeneratePlotFromPyramid(const std::string& filename, const MinMaxPyramid& pyramid);
 bool GenerateSimplePlot(const std::string& filename, 
     std::vector<double>& xs, 
     std::vector<double>& ys);
 bool GenerateEmptyPlot(const std::string& filename);
+// Draws the frame of the last plot again for a new x/y range, keeping
+// plot_series as it is; for panning and zooming the recorded series.
+bool RedrawPlotFrame(double xmin, double xmax, double ymin, double ymax);
 bool ContinuousPlot(const std::string& filename, ScatterPlotSeries *series);
 void FinishContinuousPlot();
 
+// Live plot of samples arriving over time (see sample_stream.h), drawn
+// into plot_canvas. The x range is a window of the given width that starts
+// at the first sample and scrolls along with the newest one; the y range
+// starts as plot_data's and grows to fit. Each append only rasterizes the
+// segments it adds, and scrolling moves the pixels already drawn.
+bool BeginLivePlot(double window);
+bool AppendLivePlot(const double* xs, const double* ys, size_t count);
+// Ends the live plot and writes plot_canvas to filename, if any.
+bool FinishLivePlot(const std::string& filename);
+
+// Templated variants: gen is inlined into the sampling loop and the samples
+// are written straight into the series storage. Lambdas pick these up over
+// the std::function overloads above.
+template <typename Gen>
+bool GeneratePlotFromFunc(const std::string& filename,
+    const Gen & gen, const uint32_t & num, double xmin, double xmax)
+{
+    ScatterPlotSeries *series = NewLineSeries(size_t(num) + 1);
+    if (plot_data.parallel_sampling)
+        SampleFunctionParallel(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    else
+        SampleFunction(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    return GeneratePlot(filename, series);
+}
+
+template <typename Gen>
+bool GenerateContinuousPlotFromFunc(const std::string& filename,
+    const Gen & gen, const uint32_t & num, double xmin, double xmax)
+{
+    ScatterPlotSeries *series = NewLineSeries(size_t(num) + 1);
+    if (plot_data.parallel_sampling)
+        SampleFunctionParallel(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    else
+        SampleFunction(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    return ContinuousPlot(filename, series);
+}
+
+// Batch variants: gen is void(const double* xs, double* ys, size_t n), e.g.
+// SinBatch, and is called once for the whole grid.
+template <typename BatchGen>
+bool GeneratePlotFromBatch(const std::string& filename,
+    const BatchGen & gen, const uint32_t & num, double xmin, double xmax)
+{
+    ScatterPlotSeries *series = NewLineSeries(size_t(num) + 1);
+    if (plot_data.parallel_sampling)
+        SampleFunctionBatchParallel(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    else
+        SampleFunctionBatch(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    return GeneratePlot(filename, series);
+}
+
+template <typename BatchGen>
+bool GenerateContinuousPlotFromBatch(const std::string& filename,
+    const BatchGen & gen, const uint32_t & num, double xmin, double xmax)
+{
+    ScatterPlotSeries *series = NewLineSeries(size_t(num) + 1);
+    if (plot_data.parallel_sampling)
+        SampleFunctionBatchParallel(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    else
+        SampleFunctionBatch(gen, num, xmin, xmax, series->xs->data(), series->ys->data());
+    return ContinuousPlot(filename, series);
+}
+
 
 #endif // PLOTTER_H
\ No newline at end of file
@@ -0,0 +1,859 @@
+#include "png.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+
+namespace {
+
+const size_t BYTES_PER_PIXEL = 4;
+
+const size_t WINDOW = 32768;
+const int HASH_BITS = 15;
+const size_t HASH_SIZE = size_t(1) << HASH_BITS;
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+
+// Symbols collected before a Huffman block is written out.
+const size_t BLOCK_SYMBOLS = size_t(1) << 15;
+
+// Bands smaller than this lose too much compression to their fresh
+// dictionaries.
+const size_t MIN_BAND_BYTES = 256 * 1024;
+
+const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23,
+    27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int DIST_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97,
+    129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+    12289, 16385, 24577 };
+const int DIST_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// Order in which the code length code lengths are stored.
+const int CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4,
+    12, 3, 13, 2, 14, 1, 15 };
+
+struct SymbolTables
+{
+    uint8_t length_code[MAX_MATCH + 1];
+    // distance code of d - 1 below 256, and of (d - 1) >> 7 above
+    uint8_t dist_low[256];
+    uint8_t dist_high[256];
+
+    SymbolTables()
+    {
+        for (int c = 0; c < 29; c++)
+            for (int l = LENGTH_BASE[c];
+                 l < LENGTH_BASE[c] + (1 << LENGTH_EXTRA[c]) && l <= MAX_MATCH;
+                 l++)
+                length_code[l] = (uint8_t)c;
+        // 258 has a code of its own instead of being 227 + 31
+        length_code[MAX_MATCH] = 28;
+
+        for (int c = 0; c < 30; c++)
+            for (int d = DIST_BASE[c]; d < DIST_BASE[c] + (1 << DIST_EXTRA[c]);
+                 d++)
+            {
+                if (d - 1 < 256)
+                    dist_low[d - 1] = (uint8_t)c;
+                else
+                    dist_high[(d - 1) >> 7] = (uint8_t)c;
+            }
+    }
+
+    int DistCode(int dist) const
+    {
+        return dist - 1 < 256 ? dist_low[dist - 1] : dist_high[(dist - 1) >> 7];
+    }
+};
+
+const SymbolTables& Tables()
+{
+    static const SymbolTables tables;
+    return tables;
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t n)
+{
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+const uint32_t ADLER_BASE = 65521;
+
+uint32_t Adler32(const uint8_t* data, size_t n)
+{
+    uint32_t a = 1, b = 0;
+
+    while (n > 0)
+    {
+        // largest run that cannot overflow b before the modulo
+        const size_t run = std::min<size_t>(n, 5552);
+        for (size_t i = 0; i < run; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+        data += run;
+        n -= run;
+    }
+    return a | (b << 16);
+}
+
+// Adler-32 of two concatenated buffers from the checksums of each, the
+// second one being len2 bytes long (same as zlib's adler32_combine).
+uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+    const uint32_t rem = (uint32_t)(len2 % ADLER_BASE);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % ADLER_BASE);
+
+    sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if (sum1 >= ADLER_BASE)
+        sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE)
+        sum1 -= ADLER_BASE;
+    if (sum2 >= 2 * ADLER_BASE)
+        sum2 -= 2 * ADLER_BASE;
+    if (sum2 >= ADLER_BASE)
+        sum2 -= ADLER_BASE;
+    return sum1 | (sum2 << 16);
+}
+
+// Deflate bit stream, least significant bit first.
+struct BitWriter
+{
+    std::vector<uint8_t>* out;
+    uint64_t bits=0;
+    int count=0;
+
+    void Put(uint32_t value, int n)
+    {
+        bits |= (uint64_t)value << count;
+        count += n;
+        while (count >= 8)
+        {
+            out->push_back((uint8_t)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void Align()
+    {
+        if (count > 0)
+            out->push_back((uint8_t)bits);
+        bits = 0;
+        count = 0;
+    }
+};
+
+struct HuffmanCode
+{
+    std::vector<uint8_t> lengths;
+    // bit reversed, ready for BitWriter
+    std::vector<uint16_t> codes;
+};
+
+// Canonical codes for the given lengths, RFC 1951 section 3.2.2.
+void AssignCodes(HuffmanCode* code)
+{
+    int count[16] = { 0 };
+    int next[16] = { 0 };
+
+    for (uint8_t l : code->lengths)
+        count[l]++;
+    count[0] = 0;
+    for (int bits = 1, c = 0; bits < 16; bits++)
+    {
+        c = (c + count[bits - 1]) << 1;
+        next[bits] = c;
+    }
+
+    code->codes.assign(code->lengths.size(), 0);
+    for (size_t s = 0; s < code->lengths.size(); s++)
+    {
+        const int l = code->lengths[s];
+        if (l == 0)
+            continue;
+
+        uint32_t c = next[l]++, r = 0;
+        for (int k = 0; k < l; k++, c >>= 1)
+            r = (r << 1) | (c & 1);
+        code->codes[s] = (uint16_t)r;
+    }
+}
+
+// Huffman code lengths of at most max_bits for the frequencies. At least
+// two symbols always get a code, a single code would be incomplete, which
+// inflaters do not accept everywhere.
+void BuildCode(HuffmanCode* code, std::vector<uint32_t> freqs, int max_bits)
+{
+    const size_t n = freqs.size();
+    size_t used = 0;
+
+    for (uint32_t f : freqs)
+        used += f > 0;
+    for (size_t s = 0; used < 2 && s < n; s++)
+    {
+        if (freqs[s] == 0)
+        {
+            freqs[s] = 1;
+            used++;
+        }
+    }
+
+    // Plain Huffman tree over the used symbols; leaves are 0..n-1, inner
+    // nodes follow. Lengths are read back by walking up to the root.
+    std::vector<int> parent(2 * n, -1);
+    typedef std::pair<uint64_t, int> Node;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+    int next = (int)n;
+
+    for (size_t s = 0; s < n; s++)
+        if (freqs[s] > 0)
+            queue.push(Node(freqs[s], (int)s));
+    while (queue.size() > 1)
+    {
+        const Node a = queue.top();
+        queue.pop();
+        const Node b = queue.top();
+        queue.pop();
+        parent[a.second] = next;
+        parent[b.second] = next;
+        queue.push(Node(a.first + b.first, next++));
+    }
+
+    // Number of codes of each length, with the ones too long counted at
+    // max_bits.
+    std::vector<int> count(max_bits + 1, 0);
+    for (size_t s = 0; s < n; s++)
+    {
+        if (freqs[s] == 0)
+            continue;
+        int depth = 0;
+        for (int p = parent[s]; p >= 0; p = parent[p])
+            depth++;
+        count[std::min(depth, max_bits)]++;
+    }
+
+    // Clamping overfills the code. Like zlib and miniz, move one max_bits
+    // code down at a time: it becomes the sibling of a shorter code, which
+    // is lengthened by one. That takes exactly one unit off the Kraft sum,
+    // counted in units of 2^-max_bits, so the code ends up complete.
+    int64_t kraft = 0;
+    for (int l = 1; l <= max_bits; l++)
+        kraft += int64_t(count[l]) << (max_bits - l);
+    for (; kraft > (int64_t(1) << max_bits); kraft--)
+    {
+        count[max_bits]--;
+        for (int l = max_bits - 1; l > 0; l--)
+        {
+            if (count[l] > 0)
+            {
+                count[l]--;
+                count[l + 1] += 2;
+                break;
+            }
+        }
+    }
+
+    // The shortest codes go to the most frequent symbols.
+    std::vector<int> order;
+    for (size_t s = 0; s < n; s++)
+        if (freqs[s] > 0)
+            order.push_back((int)s);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return freqs[a] > freqs[b]; });
+
+    code->lengths.assign(n, 0);
+    size_t k = 0;
+    for (int l = 1; l <= max_bits; l++)
+        for (int c = 0; c < count[l]; c++)
+            code->lengths[order[k++]] = (uint8_t)l;
+
+    AssignCodes(code);
+}
+
+void FixedCodes(HuffmanCode* lit, HuffmanCode* dist)
+{
+    lit->lengths.assign(288, 8);
+    std::fill(lit->lengths.begin() + 144, lit->lengths.begin() + 256, 9);
+    std::fill(lit->lengths.begin() + 256, lit->lengths.begin() + 280, 7);
+    dist->lengths.assign(30, 5);
+    AssignCodes(lit);
+    AssignCodes(dist);
+}
+
+// Literal (dist == 0) or match of the LZ77 stage.
+struct Symbol
+{
+    uint16_t value;
+    uint16_t dist;
+};
+
+// Code length symbols (0-18) with their extra bits, for a dynamic header.
+void RunLengthCode(const std::vector<uint8_t>& lengths,
+    std::vector<std::pair<int, int>>* out)
+{
+    size_t i = 0;
+
+    while (i < lengths.size())
+    {
+        const int l = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == l)
+            run++;
+
+        if (l == 0 && run >= 3)
+        {
+            const size_t r = std::min<size_t>(run, 138);
+            out->push_back(r >= 11 ? std::make_pair(18, (int)r - 11)
+                                   : std::make_pair(17, (int)r - 3));
+            i += r;
+        }
+        else if (l != 0 && run >= 4)
+        {
+            // the length itself, then repeats of it
+            const size_t r = std::min<size_t>(run - 1, 6);
+            out->push_back(std::make_pair(l, 0));
+            out->push_back(std::make_pair(16, (int)r - 3));
+            i += r + 1;
+        }
+        else
+        {
+            out->push_back(std::make_pair(l, 0));
+            i++;
+        }
+    }
+}
+
+void WriteBlock(BitWriter* writer, const std::vector<Symbol>& symbols,
+    bool final, bool dynamic)
+{
+    const SymbolTables& tables = Tables();
+    std::vector<uint32_t> lit_freqs(286, 0), dist_freqs(30, 0);
+
+    for (const Symbol& s : symbols)
+    {
+        if (s.dist == 0)
+        {
+            lit_freqs[s.value]++;
+        }
+        else
+        {
+            lit_freqs[257 + tables.length_code[s.value]]++;
+            dist_freqs[tables.DistCode(s.dist)]++;
+        }
+    }
+    lit_freqs[256]++;
+
+    HuffmanCode lit, dist;
+    FixedCodes(&lit, &dist);
+
+    HuffmanCode dyn_lit, dyn_dist, dyn_lengths;
+    std::vector<std::pair<int, int>> rle;
+    size_t hlit = 0, hdist = 0, hclen = 0;
+
+    if (dynamic)
+    {
+        BuildCode(&dyn_lit, lit_freqs, 15);
+        BuildCode(&dyn_dist, dist_freqs, 15);
+
+        hlit = 286;
+        while (hlit > 257 && dyn_lit.lengths[hlit - 1] == 0)
+            hlit--;
+        hdist = 30;
+        while (hdist > 1 && dyn_dist.lengths[hdist - 1] == 0)
+            hdist--;
+
+        // literal and distance lengths are run length coded as one sequence
+        std::vector<uint8_t> all(dyn_lit.lengths.begin(),
+                                 dyn_lit.lengths.begin() + hlit);
+        all.insert(all.end(), dyn_dist.lengths.begin(),
+                   dyn_dist.lengths.begin() + hdist);
+        RunLengthCode(all, &rle);
+
+        std::vector<uint32_t> length_freqs(19, 0);
+        for (const std::pair<int, int>& r : rle)
+            length_freqs[r.first]++;
+        BuildCode(&dyn_lengths, length_freqs, 7);
+
+        hclen = 19;
+        while (hclen > 4 && dyn_lengths.lengths[CODE_LENGTH_ORDER[hclen - 1]] == 0)
+            hclen--;
+
+        // keep the fixed codes if they come out smaller
+        uint64_t fixed_bits = 0, dynamic_bits = 14 + hclen * 3;
+        for (size_t s = 0; s < 286; s++)
+        {
+            fixed_bits += (uint64_t)lit_freqs[s] * lit.lengths[s];
+            dynamic_bits += (uint64_t)lit_freqs[s] * dyn_lit.lengths[s];
+        }
+        for (size_t s = 0; s < 30; s++)
+        {
+            fixed_bits += (uint64_t)dist_freqs[s] * dist.lengths[s];
+            dynamic_bits += (uint64_t)dist_freqs[s] * dyn_dist.lengths[s];
+        }
+        for (const std::pair<int, int>& r : rle)
+            dynamic_bits += dyn_lengths.lengths[r.first]
+                + (r.first == 16 ? 2 : r.first == 17 ? 3 : r.first == 18 ? 7 : 0);
+
+        dynamic = dynamic_bits < fixed_bits;
+    }
+
+    writer->Put(final ? 1 : 0, 1);
+    writer->Put(dynamic ? 2 : 1, 2);
+
+    if (dynamic)
+    {
+        writer->Put((uint32_t)(hlit - 257), 5);
+        writer->Put((uint32_t)(hdist - 1), 5);
+        writer->Put((uint32_t)(hclen - 4), 4);
+        for (size_t k = 0; k < hclen; k++)
+            writer->Put(dyn_lengths.lengths[CODE_LENGTH_ORDER[k]], 3);
+
+        for (const std::pair<int, int>& r : rle)
+        {
+            writer->Put(dyn_lengths.codes[r.first], dyn_lengths.lengths[r.first]);
+            if (r.first == 16)
+                writer->Put(r.second, 2);
+            else if (r.first == 17)
+                writer->Put(r.second, 3);
+            else if (r.first == 18)
+                writer->Put(r.second, 7);
+        }
+
+        lit = dyn_lit;
+        dist = dyn_dist;
+    }
+
+    for (const Symbol& s : symbols)
+    {
+        if (s.dist == 0)
+        {
+            writer->Put(lit.codes[s.value], lit.lengths[s.value]);
+            continue;
+        }
+
+        const int lc = tables.length_code[s.value];
+        writer->Put(lit.codes[257 + lc], lit.lengths[257 + lc]);
+        if (LENGTH_EXTRA[lc] > 0)
+            writer->Put(s.value - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+
+        const int dc = tables.DistCode(s.dist);
+        writer->Put(dist.codes[dc], dist.lengths[dc]);
+        if (DIST_EXTRA[dc] > 0)
+            writer->Put(s.dist - DIST_BASE[dc], DIST_EXTRA[dc]);
+    }
+
+    writer->Put(lit.codes[256], lit.lengths[256]);
+}
+
+// Hash chains over the last WINDOW positions of a band.
+class Matcher
+{
+public:
+    Matcher(const uint8_t* data, size_t n, int max_chain, int nice)
+        : data_(data), n_(n), max_chain_(max_chain), nice_(nice),
+          head_(HASH_SIZE, -1), prev_(WINDOW, -1)
+    {
+    }
+
+    void Insert(size_t i)
+    {
+        const uint32_t h = Hash(i);
+        prev_[i & (WINDOW - 1)] = head_[h];
+        head_[h] = (int32_t)i;
+    }
+
+    // Longest earlier match for position i, 0 if there is none of at least
+    // MIN_MATCH bytes, looking at no more than max_chain / chain_divisor
+    // candidates. Needs i + MIN_MATCH <= n.
+    int Find(size_t i, int* dist, int chain_divisor = 1) const
+    {
+        const int limit = (int)std::min<size_t>(MAX_MATCH, n_ - i);
+        const uint8_t* b = data_ + i;
+        int32_t candidate = head_[Hash(i)];
+        int best = MIN_MATCH - 1;
+
+        for (int chain = max_chain_ / chain_divisor;
+             candidate >= 0 && i - candidate < WINDOW && chain > 0; chain--)
+        {
+            const uint8_t* a = data_ + candidate;
+
+            // cheap rejections first, like zlib: the byte that would make the
+            // match longer than the best one, then the start of the match
+            if (a[best] == b[best] && a[best - 1] == b[best - 1]
+                && a[0] == b[0] && a[1] == b[1])
+            {
+                int len = 2;
+                while (len < limit && a[len] == b[len])
+                    len++;
+                if (len > best)
+                {
+                    best = len;
+                    *dist = (int)(i - candidate);
+                    if (best >= nice_ || best >= limit)
+                        break;
+                }
+            }
+
+            const int32_t next = prev_[candidate & (WINDOW - 1)];
+            if (next >= candidate)
+                break;
+            candidate = next;
+        }
+
+        return best >= MIN_MATCH ? best : 0;
+    }
+
+private:
+    uint32_t Hash(size_t i) const
+    {
+        const uint32_t v = data_[i] | (data_[i + 1] << 8) | (data_[i + 2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    const uint8_t* data_;
+    size_t n_;
+    int max_chain_;
+    int nice_;
+    std::vector<int32_t> head_;
+    std::vector<int32_t> prev_;
+};
+
+void DeflateStored(const uint8_t* data, size_t n, bool last,
+    std::vector<uint8_t>* out)
+{
+    size_t pos = 0;
+
+    do
+    {
+        const size_t len = std::min<size_t>(n - pos, 65535);
+        const bool final = last && pos + len == n;
+
+        // stored blocks start on a byte boundary, the three header bits take
+        // up a byte of their own
+        out->push_back(final ? 1 : 0);
+        out->push_back((uint8_t)len);
+        out->push_back((uint8_t)(len >> 8));
+        out->push_back((uint8_t)~len);
+        out->push_back((uint8_t)(~len >> 8));
+        out->insert(out->end(), data + pos, data + pos + len);
+        pos += len;
+    } while (pos < n);
+}
+
+// Raw deflate data for one band. A band that is not the last one ends with
+// an empty stored block, so the next band starts on a byte boundary and the
+// bands can simply be concatenated.
+void DeflateBand(const uint8_t* data, size_t n, PngLevel level, bool last,
+    std::vector<uint8_t>* out)
+{
+    if (level == PngLevel::Store)
+    {
+        DeflateStored(data, n, last, out);
+        return;
+    }
+
+    // chain and match lengths roughly those of zlib's levels 1 and 6
+    const bool high = level == PngLevel::High;
+    const int nice = high ? 128 : 32;
+    const int lazy = high ? 16 : 0;
+    Matcher matcher(data, n, high ? 128 : 8, nice);
+    BitWriter writer;
+    std::vector<Symbol> symbols;
+    bool have_next = false;
+    int next_len = 0, next_dist = 0;
+
+    writer.out = out;
+    symbols.reserve(BLOCK_SYMBOLS);
+
+    for (size_t i = 0; i < n;)
+    {
+        int len = 0, dist = 0;
+
+        if (i + MIN_MATCH <= n)
+        {
+            if (have_next)
+            {
+                len = next_len;
+                dist = next_dist;
+                have_next = false;
+            }
+            else
+            {
+                len = matcher.Find(i, &dist);
+            }
+            matcher.Insert(i);
+
+            // lazy matching: a longer match one byte later wins over a
+            // short one here
+            if (len > 0 && len < lazy && i + 1 + MIN_MATCH <= n)
+            {
+                // like zlib, look less hard when the match is good already
+                next_len = matcher.Find(i + 1, &next_dist, len >= 8 ? 4 : 1);
+                if (next_len > len)
+                {
+                    have_next = true;
+                    len = 0;
+                }
+            }
+        }
+
+        if (len > 0)
+        {
+            symbols.push_back(Symbol{ (uint16_t)len, (uint16_t)dist });
+            for (size_t k = 1; k < (size_t)len; k++)
+                if (i + k + MIN_MATCH <= n)
+                    matcher.Insert(i + k);
+            i += len;
+        }
+        else
+        {
+            symbols.push_back(Symbol{ data[i], 0 });
+            i++;
+        }
+
+        if (symbols.size() >= BLOCK_SYMBOLS)
+        {
+            WriteBlock(&writer, symbols, false, high);
+            symbols.clear();
+        }
+    }
+
+    WriteBlock(&writer, symbols, last, high);
+
+    if (!last)
+    {
+        writer.Put(0, 3);
+        writer.Align();
+        out->push_back(0x00);
+        out->push_back(0x00);
+        out->push_back(0xFF);
+        out->push_back(0xFF);
+    }
+    writer.Align();
+}
+
+uint8_t Paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return (uint8_t)a;
+    return (uint8_t)(pb <= pc ? b : c);
+}
+
+// Applies PNG filter type to row, with prev the row above (or nullptr).
+void FilterRow(int type, const uint8_t* row, const uint8_t* prev,
+    size_t stride, uint8_t* out)
+{
+    const size_t bpp = BYTES_PER_PIXEL;
+    size_t x;
+
+    // the first row has no row above, which PNG treats as zeros
+    if (!prev && type >= 2)
+        type = type == 4 ? 1 : type == 2 ? 0 : 3;
+
+    switch (type)
+    {
+    case 1:
+        for (x = 0; x < bpp; x++)
+            out[x] = row[x];
+        for (; x < stride; x++)
+            out[x] = (uint8_t)(row[x] - row[x - bpp]);
+        break;
+    case 2:
+        for (x = 0; x < stride; x++)
+            out[x] = (uint8_t)(row[x] - prev[x]);
+        break;
+    case 3:
+        for (x = 0; x < bpp; x++)
+            out[x] = (uint8_t)(row[x] - ((prev ? prev[x] : 0) >> 1));
+        for (; x < stride; x++)
+            out[x] = (uint8_t)(row[x] - ((row[x - bpp] + (prev ? prev[x] : 0)) >> 1));
+        break;
+    case 4:
+        for (x = 0; x < bpp; x++)
+            out[x] = (uint8_t)(row[x] - prev[x]);
+        for (; x < stride; x++)
+            out[x] = (uint8_t)(row[x] - Paeth(row[x - bpp], prev[x], prev[x - bpp]));
+        break;
+    default:
+        std::memcpy(out, row, stride);
+        break;
+    }
+}
+
+// Filter type byte plus filtered bytes of every row. Store keeps the rows
+// as they are, Fast uses Sub, which turns the flat runs of a plot into
+// zeros, and High picks the filter with the smallest sum of absolute
+// differences per row, the usual libpng heuristic.
+void FilterImage(const uint8_t* rgba, uint32_t width, uint32_t height,
+    PngLevel level, std::vector<uint8_t>* out)
+{
+    const size_t stride = (size_t)width * BYTES_PER_PIXEL;
+    out->resize((stride + 1) * height);
+
+    ParallelFor(0, height, std::max<size_t>(1, 65536 / (stride + 1)),
+                [&](size_t begin, size_t end) {
+        std::vector<uint8_t> trial(level == PngLevel::High ? stride : 0);
+
+        for (size_t y = begin; y < end; y++)
+        {
+            const uint8_t* row = rgba + y * stride;
+            const uint8_t* prev = y > 0 ? row - stride : nullptr;
+            uint8_t* dst = out->data() + y * (stride + 1);
+
+            if (level != PngLevel::High)
+            {
+                dst[0] = level == PngLevel::Fast ? 1 : 0;
+                FilterRow(dst[0], row, prev, stride, dst + 1);
+                continue;
+            }
+
+            uint64_t best_cost = UINT64_MAX;
+            for (int type = 0; type < 5; type++)
+            {
+                FilterRow(type, row, prev, stride, trial.data());
+
+                uint64_t cost = 0;
+                for (size_t x = 0; x < stride; x++)
+                    cost += std::abs((int)(int8_t)trial[x]);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    dst[0] = (uint8_t)type;
+                    std::memcpy(dst + 1, trial.data(), stride);
+                }
+            }
+        }
+    });
+}
+
+void PutU32(std::vector<uint8_t>* out, uint32_t v)
+{
+    out->push_back((uint8_t)(v >> 24));
+    out->push_back((uint8_t)(v >> 16));
+    out->push_back((uint8_t)(v >> 8));
+    out->push_back((uint8_t)v);
+}
+
+void PutChunk(std::vector<uint8_t>* out, const char* type,
+    const uint8_t* data, size_t n)
+{
+    PutU32(out, (uint32_t)n);
+    const size_t start = out->size();
+    out->insert(out->end(), type, type + 4);
+    out->insert(out->end(), data, data + n);
+    PutU32(out, Crc32(0, out->data() + start, n + 4));
+}
+
+}
+
+void EncodePNG(std::vector<uint8_t>* out, const uint8_t* rgba, uint32_t width,
+    uint32_t height, PngLevel level)
+{
+    std::vector<uint8_t> filtered;
+    FilterImage(rgba, width, height, level, &filtered);
+
+    const size_t row_bytes = (size_t)width * BYTES_PER_PIXEL + 1;
+    const size_t band_rows = std::max<size_t>(
+        1, (MIN_BAND_BYTES + row_bytes - 1) / row_bytes);
+    const size_t bands = std::max<size_t>(1, (height + band_rows - 1) / band_rows);
+
+    std::vector<std::vector<uint8_t>> deflated(bands);
+    std::vector<uint32_t> adlers(bands);
+
+    ParallelFor(0, bands, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++)
+        {
+            const size_t first = b * band_rows * row_bytes;
+            const size_t last = std::min(filtered.size(), first + band_rows * row_bytes);
+
+            deflated[b].reserve((last - first) / 2);
+            DeflateBand(filtered.data() + first, last - first, level,
+                        b + 1 == bands, &deflated[b]);
+            adlers[b] = Adler32(filtered.data() + first, last - first);
+        }
+    });
+
+    // zlib stream: header, the bands back to back, Adler-32 of the whole
+    std::vector<uint8_t> zlib;
+    size_t zlib_size = 6;
+    for (const std::vector<uint8_t>& d : deflated)
+        zlib_size += d.size();
+    zlib.reserve(zlib_size);
+
+    zlib.push_back(0x78);
+    zlib.push_back(level == PngLevel::High ? 0xDA : 0x01);
+    uint32_t adler = adlers[0];
+    for (size_t b = 0; b < bands; b++)
+    {
+        zlib.insert(zlib.end(), deflated[b].begin(), deflated[b].end());
+        if (b > 0)
+        {
+            const size_t first = b * band_rows * row_bytes;
+            const size_t len = std::min(filtered.size(), first + band_rows * row_bytes) - first;
+            adler = Adler32Combine(adler, adlers[b], len);
+        }
+    }
+    PutU32(&zlib, adler);
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> header;
+    PutU32(&header, width);
+    PutU32(&header, height);
+    header.push_back(8); // bit depth
+    header.push_back(6); // RGBA
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+
+    out->clear();
+    out->reserve(zlib.size() + 64);
+    out->insert(out->end(), signature, signature + 8);
+    PutChunk(out, "IHDR", header.data(), header.size());
+    PutChunk(out, "IDAT", zlib.data(), zlib.size());
+    PutChunk(out, "IEND", nullptr, 0);
+}
+
+bool WritePNG(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height, PngLevel level)
+{
+    if (!rgba || width == 0 || height == 0)
+        return false;
+
+    std::vector<uint8_t> png;
+    EncodePNG(&png, rgba, width, height, level);
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write((const char*)png.data(), (std::streamsize)png.size());
+    return (bool)file;
+}
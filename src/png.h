@@ -0,0 +1,34 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class PngLevel
+{
+    // no compression, the file is written at memcpy speed
+    Store,
+    // Sub filter, short hash chains and fixed Huffman codes; for replots
+    Fast,
+    // per row filter choice, lazy matching and dynamic Huffman codes; for
+    // exports that are kept
+    High,
+};
+
+/**
+ * @brief Encodes an 8-bit RGBA image, rows top to bottom without padding,
+ * into a PNG file in memory.
+ *
+ * Rows are filtered in parallel, then the image is cut into bands of rows
+ * that are deflated in parallel on the worker pool and joined into a single
+ * zlib stream. Every band starts with an empty dictionary, which costs a
+ * little compression at the band edges.
+ */
+void EncodePNG(std::vector<uint8_t>* out, const uint8_t* rgba, uint32_t width,
+    uint32_t height, PngLevel level);
+
+bool WritePNG(const std::string& filename, const uint8_t* rgba,
+    uint32_t width, uint32_t height, PngLevel level);
+
+#endif // PNG_H
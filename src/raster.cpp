@@ -0,0 +1,284 @@
+#include "raster.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// How far outside its defining points a command can put pixels.
+int Reach(const RasterList& list, const RasterCommand& command)
+{
+    switch (command.shape)
+    {
+    case RasterShape::Line:
+    case RasterShape::PatternedLine:
+        return std::max(1, (int)std::lround(list.styles[command.style].thickness));
+    case RasterShape::Cross:
+        return 2;
+    default:
+        return command.x1 + 1;
+    }
+}
+
+// Calls visit(tile) for every tile of a tiles_x by tiles_y grid the command
+// may touch. Lines only visit the tiles along their path, not their whole
+// bounding box.
+template <typename Visit>
+void ForEachTile(const RasterList& list, const RasterCommand& command,
+    int tiles_x, int tiles_y, Visit visit)
+{
+    const int reach = Reach(list, command);
+    const bool line = command.shape == RasterShape::Line
+        || command.shape == RasterShape::PatternedLine;
+
+    const int x_lo = line ? std::min(command.x0, command.x1) : command.x0;
+    const int x_hi = line ? std::max(command.x0, command.x1) : command.x0;
+    const int y_lo = line ? std::min(command.y0, command.y1) : command.y0;
+    const int y_hi = line ? std::max(command.y0, command.y1) : command.y0;
+
+    const int ty0 = std::max(0, (y_lo - reach) / RASTER_TILE);
+    const int ty1 = std::min(tiles_y - 1, (y_hi + reach) / RASTER_TILE);
+    if (y_hi + reach < 0 || x_hi + reach < 0)
+        return;
+
+    for (int ty = ty0; ty <= ty1; ty++)
+    {
+        int row_x_lo = x_lo;
+        int row_x_hi = x_hi;
+
+        if (line && command.y0 != command.y1)
+        {
+            // x range of the line within the rows of this tile, widened by
+            // the brush and by Bresenham's half pixel of rounding
+            const int band_lo = std::min(std::max(ty * RASTER_TILE - reach, y_lo), y_hi);
+            const int band_hi = std::min(std::max((ty + 1) * RASTER_TILE - 1 + reach, y_lo), y_hi);
+            const double slope = (double)(command.x1 - command.x0)
+                / (command.y1 - command.y0);
+            const double xa = command.x0 + (band_lo - command.y0) * slope;
+            const double xb = command.x0 + (band_hi - command.y0) * slope;
+
+            row_x_lo = (int)std::floor(std::min(xa, xb)) - 1;
+            row_x_hi = (int)std::ceil(std::max(xa, xb)) + 1;
+        }
+
+        if (row_x_hi + reach < 0)
+            continue;
+
+        const int tx0 = std::max(0, (row_x_lo - reach) / RASTER_TILE);
+        const int tx1 = std::min(tiles_x - 1, (row_x_hi + reach) / RASTER_TILE);
+
+        for (int tx = tx0; tx <= tx1; tx++)
+            visit((size_t)ty * tiles_x + tx);
+    }
+}
+
+// Grows rect by the bounding box of the pixels the command may touch.
+void GrowByCommand(CanvasClip* rect, const RasterList& list,
+    const RasterCommand& command)
+{
+    const bool line = command.shape == RasterShape::Line
+        || command.shape == RasterShape::PatternedLine;
+    // Bresenham rounds by up to half a pixel on top of the brush
+    const int reach = Reach(list, command) + 1;
+
+    CanvasClip box;
+    box.x0 = (line ? std::min(command.x0, command.x1) : command.x0) - reach;
+    box.y0 = (line ? std::min(command.y0, command.y1) : command.y0) - reach;
+    box.x1 = (line ? std::max(command.x0, command.x1) : command.x0) + reach;
+    box.y1 = (line ? std::max(command.y0, command.y1) : command.y0) + reach;
+    CanvasGrowRect(rect, box);
+}
+
+void DrawCommand(Canvas* canvas, const RasterList& list,
+    const RasterCommand& command, const CanvasClip* clip)
+{
+    const RasterStyle& style = list.styles[command.style];
+    const int x = command.x0;
+    const int y = command.y0;
+
+    switch (command.shape)
+    {
+    case RasterShape::Line:
+        CanvasDrawLine(canvas, x, y, command.x1, command.y1, style.thickness,
+                       style.color, clip);
+        break;
+    case RasterShape::PatternedLine:
+    {
+        double offset = command.offset;
+        CanvasDrawLinePatterned(canvas, x, y, command.x1, command.y1,
+                                style.thickness, *style.pattern, &offset,
+                                style.color, clip);
+        break;
+    }
+    case RasterShape::Pixel:
+        CanvasDrawPixel(canvas, x, y, style.color, clip);
+        break;
+    case RasterShape::Cross:
+        CanvasDrawPixel(canvas, x, y, style.color, clip);
+        CanvasDrawPixel(canvas, x + 1, y, style.color, clip);
+        CanvasDrawPixel(canvas, x + 2, y, style.color, clip);
+        CanvasDrawPixel(canvas, x - 1, y, style.color, clip);
+        CanvasDrawPixel(canvas, x - 2, y, style.color, clip);
+        CanvasDrawPixel(canvas, x, y + 1, style.color, clip);
+        CanvasDrawPixel(canvas, x, y + 2, style.color, clip);
+        CanvasDrawPixel(canvas, x, y - 1, style.color, clip);
+        CanvasDrawPixel(canvas, x, y - 2, style.color, clip);
+        break;
+    case RasterShape::Circle:
+        CanvasDrawCircle(canvas, x, y, command.x1, style.color, clip);
+        break;
+    case RasterShape::FilledCircle:
+        CanvasDrawFilledCircle(canvas, x, y, command.x1, style.color, clip);
+        break;
+    case RasterShape::Triangle:
+        CanvasDrawTriangle(canvas, x, y, command.x1, style.color, clip);
+        break;
+    case RasterShape::FilledTriangle:
+        CanvasDrawFilledTriangle(canvas, x, y, command.x1, style.color, clip);
+        break;
+    }
+}
+
+}
+
+void RasterClear(RasterList* list)
+{
+    list->styles.clear();
+    list->commands.clear();
+}
+
+uint32_t RasterAddStyle(RasterList* list, const Color8& color,
+    double thickness, const std::vector<bool>* pattern)
+{
+    RasterStyle style;
+    style.color = color;
+    style.thickness = thickness;
+    style.pattern = pattern;
+
+    list->styles.push_back(style);
+    return (uint32_t)(list->styles.size() - 1);
+}
+
+void RasterAddLine(RasterList* list, uint32_t style, int x0, int y0, int x1,
+    int y1, double* offset)
+{
+    const std::vector<bool>* pattern = list->styles[style].pattern;
+    RasterCommand command;
+
+    command.x0 = x0;
+    command.y0 = y0;
+    command.x1 = x1;
+    command.y1 = y1;
+    command.offset = 0.0;
+    command.style = style;
+    command.shape = RasterShape::Line;
+
+    if (pattern)
+    {
+        command.shape = RasterShape::PatternedLine;
+        command.offset = *offset;
+        *offset = CanvasAdvancePattern(x0, y0, x1, y1,
+                                       list->styles[style].thickness,
+                                       *pattern, *offset);
+    }
+
+    list->commands.push_back(command);
+}
+
+void RasterAddLines(RasterList* list, uint32_t style,
+    const PixelSegment* segments, size_t count, double* offset)
+{
+    list->commands.reserve(list->commands.size() + count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const PixelSegment& s = segments[i];
+        RasterAddLine(list, style, s.x0, s.y0, s.x1, s.y1, offset);
+    }
+}
+
+void RasterAddMarker(RasterList* list, uint32_t style, RasterShape shape,
+    int x, int y, int size)
+{
+    RasterCommand command;
+
+    command.x0 = x;
+    command.y0 = y;
+    command.x1 = size;
+    command.y1 = 0;
+    command.offset = 0.0;
+    command.style = style;
+    command.shape = shape;
+
+    list->commands.push_back(command);
+}
+
+void RasterDraw(Canvas* canvas, RasterList* list, CanvasClip* dirty)
+{
+    const std::vector<RasterCommand>& commands = list->commands;
+
+    if (dirty && !commands.empty())
+    {
+        CanvasClip touched;
+        for (const RasterCommand& command : commands)
+            GrowByCommand(&touched, *list, command);
+
+        // only what lies on the canvas
+        const CanvasClip all = CanvasRect(*canvas);
+        touched.x0 = std::max(touched.x0, all.x0);
+        touched.y0 = std::max(touched.y0, all.y0);
+        touched.x1 = std::min(touched.x1, all.x1);
+        touched.y1 = std::min(touched.y1, all.y1);
+        CanvasGrowRect(dirty, touched);
+    }
+
+    if (commands.size() < RASTER_PARALLEL_MIN_COMMANDS
+        || ParallelWorkers() <= 1)
+    {
+        for (const RasterCommand& command : commands)
+            DrawCommand(canvas, *list, command, nullptr);
+        RasterClear(list);
+        return;
+    }
+
+    const int tiles_x = ((int)canvas->width + RASTER_TILE - 1) / RASTER_TILE;
+    const int tiles_y = ((int)canvas->height + RASTER_TILE - 1) / RASTER_TILE;
+    const size_t tiles = (size_t)tiles_x * tiles_y;
+
+    // Counting sort of the commands into their tiles. After counting and
+    // summing up, starts[t] is one past the end of tile t; filling in from
+    // the last command backwards then leaves starts[t] at the beginning of
+    // tile t with its commands in recording order.
+    std::vector<uint32_t>& starts = list->tile_starts;
+    std::vector<uint32_t>& binned = list->tile_commands;
+
+    starts.assign(tiles + 1, 0);
+    for (const RasterCommand& command : commands)
+        ForEachTile(*list, command, tiles_x, tiles_y,
+                    [&](size_t tile) { starts[tile]++; });
+
+    for (size_t t = 1; t <= tiles; t++)
+        starts[t] += starts[t - 1];
+    binned.resize(starts[tiles]);
+
+    for (size_t i = commands.size(); i-- > 0;)
+        ForEachTile(*list, commands[i], tiles_x, tiles_y,
+                    [&](size_t tile) { binned[--starts[tile]] = (uint32_t)i; });
+
+    ParallelFor(0, tiles, 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++)
+        {
+            CanvasClip clip;
+            clip.x0 = (int)(t % tiles_x) * RASTER_TILE;
+            clip.y0 = (int)(t / tiles_x) * RASTER_TILE;
+            clip.x1 = clip.x0 + RASTER_TILE - 1;
+            clip.y1 = clip.y0 + RASTER_TILE - 1;
+
+            for (uint32_t k = starts[t]; k < starts[t + 1]; k++)
+                DrawCommand(canvas, *list, commands[binned[k]], &clip);
+        }
+    });
+
+    RasterClear(list);
+}
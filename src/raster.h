@@ -0,0 +1,89 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "canvas.h"
+#include "clip.h"
+
+// Side length in pixels of the square tiles RasterDraw renders in parallel.
+const int RASTER_TILE = 64;
+
+// Lists with fewer commands than this are drawn directly on the calling
+// thread, binning them would cost more than it saves.
+const size_t RASTER_PARALLEL_MIN_COMMANDS = 4096;
+
+enum class RasterShape : uint8_t
+{
+    Line,
+    PatternedLine,
+    Pixel,
+    Cross,
+    Circle,
+    FilledCircle,
+    Triangle,
+    FilledTriangle,
+};
+
+struct RasterStyle
+{
+    Color8 color;
+    double thickness=1.0;
+    // only used by PatternedLine, must outlive the list
+    const std::vector<bool>* pattern=nullptr;
+};
+
+// One shape to draw. Lines go from (x0, y0) to (x1, y1), markers are
+// centered on (x0, y0) with x1 as their size.
+struct RasterCommand
+{
+    int x0, y0, x1, y1;
+    // pattern offset at the start of a PatternedLine
+    double offset;
+    uint32_t style;
+    RasterShape shape;
+};
+
+// Shapes recorded in drawing order, to be rasterized by RasterDraw. The bins
+// are scratch space kept between draws.
+struct RasterList
+{
+    std::vector<RasterStyle> styles;
+    std::vector<RasterCommand> commands;
+
+    std::vector<uint32_t> tile_starts;
+    std::vector<uint32_t> tile_commands;
+};
+
+void RasterClear(RasterList* list);
+uint32_t RasterAddStyle(RasterList* list, const Color8& color,
+    double thickness, const std::vector<bool>* pattern = nullptr);
+
+/**
+ * @brief Records a line in the given style. For a patterned style the
+ * pattern starts at *offset, which is advanced past the line the same way
+ * CanvasDrawLinePatterned would, so consecutive lines continue the pattern.
+ */
+void RasterAddLine(RasterList* list, uint32_t style, int x0, int y0, int x1,
+    int y1, double* offset);
+void RasterAddLines(RasterList* list, uint32_t style,
+    const PixelSegment* segments, size_t count, double* offset);
+void RasterAddMarker(RasterList* list, uint32_t style, RasterShape shape,
+    int x, int y, int size);
+
+/**
+ * @brief Draws all recorded commands onto the canvas and clears the list.
+ *
+ * Every command is binned into the RASTER_TILE tiles it may touch and the
+ * tiles are drawn in parallel on the worker pool, each one clipped to its
+ * own rectangle. A tile draws its commands in recording order, so every
+ * pixel is blended in the same order as when drawing serially and the
+ * result is identical.
+ *
+ * @param dirty If given, grown to cover every pixel the commands may have
+ * changed, so callers can pass on just that part of the canvas.
+ */
+void RasterDraw(Canvas* canvas, RasterList* list, CanvasClip* dirty = nullptr);
+
+#endif // RASTER_H
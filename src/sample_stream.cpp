@@ -0,0 +1,339 @@
+#include "sample_stream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Bytes read from the stream at once.
+const size_t STREAM_READ_SIZE = 1 << 16;
+
+// How long StopSampleStream waits for the reader before leaving it be.
+const int STREAM_STOP_MS = 250;
+
+// Single producer, single consumer queue of samples. Each counter is only
+// written by its own side: slots from popped up to pushed hold samples for
+// the render loop, the others are free for the reader.
+struct SampleRing
+{
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::atomic<uint64_t> pushed{ 0 };
+    std::atomic<uint64_t> popped{ 0 };
+};
+
+struct SampleReader
+{
+    std::thread thread;
+    std::atomic<bool> stop{ false };
+    std::atomic<bool> finished{ false };
+
+    // set by the reader thread before finished
+    std::string error;
+
+    SampleRing ring;
+};
+
+SampleReader reader_;
+
+#ifdef _WIN32
+
+int OpenStream(const std::string& filename)
+{
+    if (filename == "-")
+    {
+        _setmode(0, _O_BINARY);
+        return 0;
+    }
+    return _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+}
+
+// There is no poll() for pipes, reads just block.
+bool WaitReadable(int fd)
+{
+    return true;
+}
+
+long ReadStream(int fd, char* buffer, size_t size)
+{
+    return _read(fd, buffer, (unsigned)size);
+}
+
+void CloseStream(int fd)
+{
+    if (fd != 0)
+        _close(fd);
+}
+
+#else
+
+int OpenStream(const std::string& filename)
+{
+    return filename == "-" ? 0 : open(filename.c_str(), O_RDONLY);
+}
+
+// Waits a little for data, so the reader keeps checking for stop.
+bool WaitReadable(int fd)
+{
+    pollfd p = { fd, POLLIN, 0 };
+    return poll(&p, 1, 100) != 0;
+}
+
+long ReadStream(int fd, char* buffer, size_t size)
+{
+    return read(fd, buffer, size);
+}
+
+void CloseStream(int fd)
+{
+    if (fd != 0)
+        close(fd);
+}
+
+#endif
+
+// Copies as many samples as there is room for into the ring.
+size_t PushSamples(SampleRing* ring, const double* xs, const double* ys,
+    size_t count)
+{
+    const size_t capacity = ring->xs.size();
+    const uint64_t pushed = ring->pushed.load(std::memory_order_relaxed);
+    const uint64_t popped = ring->popped.load(std::memory_order_acquire);
+    const size_t n = std::min(count, capacity - size_t(pushed - popped));
+
+    // in two parts where the free slots wrap around
+    const size_t start = size_t(pushed) & (capacity - 1);
+    const size_t first = std::min(n, capacity - start);
+    std::copy_n(xs, first, ring->xs.begin() + start);
+    std::copy_n(ys, first, ring->ys.begin() + start);
+    std::copy_n(xs + first, n - first, ring->xs.begin());
+    std::copy_n(ys + first, n - first, ring->ys.begin());
+
+    ring->pushed.store(pushed + n, std::memory_order_release);
+    return n;
+}
+
+// Pushes all samples, waiting while the ring is full; false if stopped.
+bool PushAll(SampleReader* reader, const std::vector<double>& xs,
+    const std::vector<double>& ys)
+{
+    size_t done = 0;
+
+    while (done < xs.size())
+    {
+        done += PushSamples(&reader->ring, xs.data() + done, ys.data() + done,
+                            xs.size() - done);
+        if (done < xs.size())
+        {
+            if (reader->stop)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    return true;
+}
+
+// Parses the whole records at the start of [text, text + size) into xs/ys
+// and returns the bytes used. With last set the stream has ended and a
+// final line without its '\n' counts as well.
+size_t ParseSamples(const char* text, size_t size, bool last,
+    StreamFormat format, const CsvOptions& options, char* delimiter,
+    std::vector<double>* xs, std::vector<double>* ys)
+{
+    xs->clear();
+    ys->clear();
+
+    if (format != StreamFormat::Text)
+    {
+        const size_t value = format == StreamFormat::Float64 ? 8 : 4;
+        const size_t count = size / (value * 2);
+        xs->resize(count);
+        ys->resize(count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const char* p = text + i * value * 2;
+            if (format == StreamFormat::Float64)
+            {
+                std::memcpy(&(*xs)[i], p, 8);
+                std::memcpy(&(*ys)[i], p + 8, 8);
+            }
+            else
+            {
+                float x, y;
+                std::memcpy(&x, p, 4);
+                std::memcpy(&y, p + 4, 4);
+                (*xs)[i] = x;
+                (*ys)[i] = y;
+            }
+        }
+        return count * value * 2;
+    }
+
+    const char* p = text;
+    const char* end = text + size;
+
+    while (p < end)
+    {
+        const void* nl = std::memchr(p, '\n', end - p);
+        if (!nl && !last)
+            break;
+        const char* eol = nl ? (const char*)nl : end;
+
+        // picked from the first line, like LoadCsvData does
+        if (*delimiter == 0 && eol > p)
+            *delimiter = CsvDelimiter(options, p, eol - p);
+
+        double x, y;
+        if (ParseCsvLine(p, eol, *delimiter, options, &x, &y))
+        {
+            xs->push_back(x);
+            ys->push_back(y);
+        }
+        p = nl ? eol + 1 : end;
+    }
+
+    return p - text;
+}
+
+void ReadSamples(SampleReader* reader, const std::string& filename,
+    StreamFormat format, const CsvOptions& options)
+{
+    const int fd = OpenStream(filename);
+    if (fd < 0)
+    {
+        reader->error = "cannot open '" + filename + "'";
+        reader->finished = true;
+        return;
+    }
+
+    // what is left of a record at the end of a read stays for the next one
+    std::vector<char> buffer(STREAM_READ_SIZE * 2);
+    std::vector<double> xs, ys;
+    char delimiter = 0;
+    size_t kept = 0;
+
+    while (!reader->stop)
+    {
+        if (!WaitReadable(fd))
+            continue;
+
+        const long n = ReadStream(fd, buffer.data() + kept,
+                                  buffer.size() - kept);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            reader->error = "cannot read '" + filename + "'";
+        if (n <= 0)
+            break;
+
+        const size_t size = kept + n;
+        const size_t used = ParseSamples(buffer.data(), size, false, format,
+                                         options, &delimiter, &xs, &ys);
+        if (!PushAll(reader, xs, ys))
+            break;
+
+        kept = size - used;
+        // a line longer than the buffer is no sample either
+        if (kept == buffer.size())
+            kept = 0;
+        std::memmove(buffer.data(), buffer.data() + used, kept);
+    }
+
+    if (!reader->stop && reader->error.empty())
+    {
+        ParseSamples(buffer.data(), kept, true, format, options, &delimiter,
+                     &xs, &ys);
+        PushAll(reader, xs, ys);
+    }
+
+    CloseStream(fd);
+    reader->finished = true;
+}
+
+}
+
+void StartSampleStream(const std::string& filename, StreamFormat format,
+    const CsvOptions& options)
+{
+    StopSampleStream();
+
+    SampleReader& r = reader_;
+    r.ring.xs.assign(STREAM_RING_CAPACITY, 0.0);
+    r.ring.ys.assign(STREAM_RING_CAPACITY, 0.0);
+    r.ring.pushed = 0;
+    r.ring.popped = 0;
+    r.stop = false;
+    r.finished = false;
+    r.error.clear();
+
+    r.thread = std::thread(ReadSamples, &r, filename, format, options);
+}
+
+size_t TakeStreamSamples(std::vector<double>* xs, std::vector<double>* ys)
+{
+    SampleRing& ring = reader_.ring;
+    const size_t capacity = ring.xs.size();
+    const uint64_t popped = ring.popped.load(std::memory_order_relaxed);
+    const uint64_t pushed = ring.pushed.load(std::memory_order_acquire);
+    const size_t n = size_t(pushed - popped);
+
+    xs->resize(n);
+    ys->resize(n);
+    if (n == 0)
+        return 0;
+
+    const size_t start = size_t(popped) & (capacity - 1);
+    const size_t first = std::min(n, capacity - start);
+    std::copy_n(ring.xs.begin() + start, first, xs->begin());
+    std::copy_n(ring.ys.begin() + start, first, ys->begin());
+    std::copy_n(ring.xs.begin(), n - first, xs->begin() + first);
+    std::copy_n(ring.ys.begin(), n - first, ys->begin() + first);
+
+    ring.popped.store(pushed, std::memory_order_release);
+    return n;
+}
+
+bool SampleStreamEnded(std::string* error)
+{
+    const SampleReader& r = reader_;
+
+    if (!r.thread.joinable() || !r.finished
+        || r.ring.pushed.load() != r.ring.popped.load())
+        return false;
+
+    *error = r.error;
+    return true;
+}
+
+void StopSampleStream()
+{
+    SampleReader& r = reader_;
+    if (!r.thread.joinable())
+        return;
+
+    r.stop = true;
+    for (int ms = 0; ms < STREAM_STOP_MS && !r.finished; ms++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // still waiting for a FIFO writer, or in a blocking read
+    if (r.finished)
+        r.thread.join();
+    else
+        r.thread.detach();
+}
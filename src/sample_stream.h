@@ -0,0 +1,49 @@
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "csv_data.h"
+
+// Samples the ring between the reader thread and the render loop holds.
+// A full ring makes the reader wait, which holds up the writer of the pipe
+// rather than dropping samples.
+const size_t STREAM_RING_CAPACITY = 1 << 20;
+
+// Text: x and y columns per line, read like a CSV file (see csv_data.h).
+// Float64/Float32: native endian x, y pairs.
+enum class StreamFormat
+{
+    Text,
+    Float64,
+    Float32,
+};
+
+/**
+ * @brief Starts a thread reading x/y samples from a pipe, FIFO or file
+ * ("-" for stdin) into the sample ring, until the stream ends or
+ * StopSampleStream is called. Opening happens on that thread too, since
+ * opening a FIFO waits for its writer.
+ */
+void StartSampleStream(const std::string& filename, StreamFormat format,
+    const CsvOptions& options);
+
+/**
+ * @brief Moves the samples read since the last call into xs/ys, oldest
+ * first, replacing their contents.
+ * @return The number of samples taken.
+ */
+size_t TakeStreamSamples(std::vector<double>* xs, std::vector<double>* ys);
+
+/**
+ * @brief Whether the stream has ended and every sample was taken. error is
+ * set if it ended on a read error rather than at its end.
+ */
+bool SampleStreamEnded(std::string* error);
+
+// Stops the reader thread. One blocked in a read on Windows is left to
+// finish on its own.
+void StopSampleStream();
+
+#endif // SAMPLE_STREAM_H
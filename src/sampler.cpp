@@ -0,0 +1,282 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <utility>
+
+namespace {
+
+struct Interval
+{
+    double xa, ya;
+    double xm, ym;
+    double xb, yb;
+
+    double error;
+
+    bool operator<(const Interval& other) const { return error < other.error; }
+};
+
+// Distance in pixels between the midpoint sample and the chord a-b.
+double DeviationPx(const Interval& in, double sx, double sy)
+{
+    const bool fa = std::isfinite(in.ya);
+    const bool fm = std::isfinite(in.ym);
+    const bool fb = std::isfinite(in.yb);
+
+    // Nothing drawable here at all (e.g. log of a negative number).
+    if (!fa && !fm && !fb)
+        return 0.0;
+    // Edge of the domain or a pole: keep narrowing it down.
+    if (!fa || !fm || !fb)
+        return INFINITY;
+
+    const double abx = (in.xb - in.xa) * sx;
+    const double aby = (in.yb - in.ya) * sy;
+    const double amx = (in.xm - in.xa) * sx;
+    const double amy = (in.ym - in.ya) * sy;
+    const double len = std::sqrt(abx * abx + aby * aby);
+
+    if (len == 0.0)
+        return std::sqrt(amx * amx + amy * amy);
+
+    return std::fabs(abx * amy - aby * amx) / len;
+}
+
+// Cody-Waite split of pi/2 and ln(2), and the Cephes minimax coefficients
+// for sin/cos on [-pi/4, pi/4] and exp on [-ln(2)/2, ln(2)/2].
+const double PIO2_1 = 1.5707962512969970703125;
+const double PIO2_2 = 7.5497894158615963534e-08;
+const double PIO2_3 = 5.3903028581581190529e-15;
+const double TWO_OVER_PI = 0.63661977236758134308;
+const double TRIG_LIMIT = 1.0e8;
+
+const double LN2_HI = 6.93145751953125e-1;
+const double LN2_LO = 1.42860682030941723212e-6;
+const double LOG2E = 1.4426950408889634074;
+const double EXP_LIMIT = 708.0;
+
+inline double SinPoly(double r)
+{
+    const double z = r * r;
+    double p = 1.58962301576546568060e-10;
+    p = p * z - 2.50507477628578072866e-8;
+    p = p * z + 2.75573136213857245213e-6;
+    p = p * z - 1.98412698295895385996e-4;
+    p = p * z + 8.33333333332211858878e-3;
+    p = p * z - 1.66666666666666307295e-1;
+    return r + r * z * p;
+}
+
+inline double CosPoly(double r)
+{
+    const double z = r * r;
+    double p = -1.13585365213876817300e-11;
+    p = p * z + 2.08757008419747316778e-9;
+    p = p * z - 2.75573141792967388112e-7;
+    p = p * z + 2.48015872888517045348e-5;
+    p = p * z - 1.38888888888730564116e-3;
+    p = p * z + 4.16666666666665929218e-2;
+    return 1.0 - 0.5 * z + z * z * p;
+}
+
+// sin(x + shift * pi/2) for |x| < TRIG_LIMIT, without branches.
+void SinQuadrantBatch(const double* xs, double* ys, size_t n, int64_t shift)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const double x = std::fabs(xs[i]) < TRIG_LIMIT ? xs[i] : 0.0;
+        const double k = std::nearbyint(x * TWO_OVER_PI);
+        const double r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+        const int64_t q = ((int64_t)k + shift) & 3;
+
+        const double s = SinPoly(r);
+        const double c = CosPoly(r);
+        const double v = (q & 1) ? c : s;
+        ys[i] = (q & 2) ? -v : v;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!(std::fabs(xs[i]) < TRIG_LIMIT))
+            ys[i] = shift ? std::cos(xs[i]) : std::sin(xs[i]);
+    }
+}
+
+}
+
+void SinBatch(const double* xs, double* ys, size_t n)
+{
+    SinQuadrantBatch(xs, ys, n, 0);
+}
+
+void CosBatch(const double* xs, double* ys, size_t n)
+{
+    SinQuadrantBatch(xs, ys, n, 1);
+}
+
+void ExpBatch(const double* xs, double* ys, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const double x = std::fabs(xs[i]) < EXP_LIMIT ? xs[i] : 0.0;
+        const double k = std::nearbyint(x * LOG2E);
+        const double r = (x - k * LN2_HI) - k * LN2_LO;
+
+        // Pade form of exp(r), as in Cephes
+        const double z = r * r;
+        double p = 1.26177193074810590878e-4;
+        p = p * z + 3.02994407707441961300e-2;
+        p = p * z + 9.99999999999999999910e-1;
+        p = p * r;
+        double q = 3.00198505138664455042e-6;
+        q = q * z + 2.52448340349684104192e-3;
+        q = q * z + 2.27265548208155028766e-1;
+        q = q * z + 2.00000000000000000009e0;
+        const double e = 1.0 + 2.0 * p / (q - p);
+
+        // 2^k built directly in the exponent bits
+        const uint64_t bits = uint64_t((int64_t)k + 1023) << 52;
+        double scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+
+        ys[i] = e * scale;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!(std::fabs(xs[i]) < EXP_LIMIT))
+            ys[i] = std::exp(xs[i]);
+    }
+}
+
+void PolynomialBatch(const std::vector<double>& coeffs, const double* xs,
+    double* ys, size_t n)
+{
+    if (coeffs.empty())
+    {
+        std::fill(ys, ys + n, 0.0);
+        return;
+    }
+
+    // Horner's scheme applied to a block of points per coefficient keeps the
+    // inner loop free of dependencies between points, so it vectorizes.
+    const size_t BLOCK = 512;
+
+    for (size_t base = 0; base < n; base += BLOCK)
+    {
+        const size_t end = std::min(n, base + BLOCK);
+
+        for (size_t i = base; i < end; i++)
+            ys[i] = coeffs.back();
+
+        for (size_t c = coeffs.size() - 1; c-- > 0;)
+        {
+            const double a = coeffs[c];
+            for (size_t i = base; i < end; i++)
+                ys[i] = ys[i] * xs[i] + a;
+        }
+    }
+}
+
+uint32_t SampleFunctionAdaptive(const std::function<double(double)>& gen,
+    double xmin, double xmax, const AdaptiveSampling& sampling,
+    std::vector<double>* xs, std::vector<double>* ys)
+{
+    std::vector<std::pair<double, double>> samples;
+    std::priority_queue<Interval> queue;
+
+    // the grid is cut down to fit the budget, down to a single interval
+    const uint32_t intervals = std::max<uint32_t>(1,
+        std::min(sampling.initial_intervals,
+                 (std::max<uint32_t>(sampling.max_evaluations, 1) - 1) / 2));
+    const uint32_t grid = intervals * 2 + 1;
+
+    samples.reserve(std::max(grid, sampling.max_evaluations));
+
+    // Initial grid: every interval gets its midpoint right away, since the
+    // midpoint is what its error estimate is based on.
+    for (uint32_t i = 0; i < grid; i++)
+    {
+        double x = xmin + (xmax - xmin) * i / (grid - 1);
+        samples.emplace_back(x, gen(x));
+    }
+    uint32_t evaluations = grid;
+
+    double y_min = sampling.y_min;
+    double y_max = sampling.y_max;
+    if (y_min == y_max)
+    {
+        y_min = INFINITY;
+        y_max = -INFINITY;
+        for (const auto& s : samples)
+        {
+            if (std::isfinite(s.second))
+            {
+                y_min = std::min(y_min, s.second);
+                y_max = std::max(y_max, s.second);
+            }
+        }
+    }
+
+    const double sx = xmax > xmin ? sampling.width_px / (xmax - xmin) : 1.0;
+    const double sy = y_max > y_min ? sampling.height_px / (y_max - y_min) : 1.0;
+
+    for (uint32_t i = 0; i < intervals; i++)
+    {
+        Interval in = { samples[2 * i].first,     samples[2 * i].second,
+                        samples[2 * i + 1].first, samples[2 * i + 1].second,
+                        samples[2 * i + 2].first, samples[2 * i + 2].second,
+                        0.0 };
+        in.error = DeviationPx(in, sx, sy);
+        queue.push(in);
+    }
+
+    // Split the worst interval at its midpoint; each half needs one new
+    // sample for its own error estimate.
+    while (!queue.empty() && evaluations + 2 <= sampling.max_evaluations)
+    {
+        const Interval in = queue.top();
+        if (in.error <= sampling.tolerance_px)
+            break;
+        queue.pop();
+
+        // Below half a pixel further splitting cannot change the image.
+        if ((in.xb - in.xa) * sx < 0.5)
+            continue;
+
+        Interval left = { in.xa, in.ya, 0.5 * (in.xa + in.xm), 0.0,
+                          in.xm, in.ym, 0.0 };
+        Interval right = { in.xm, in.ym, 0.5 * (in.xm + in.xb), 0.0,
+                           in.xb, in.yb, 0.0 };
+        left.ym = gen(left.xm);
+        right.ym = gen(right.xm);
+        evaluations += 2;
+
+        samples.emplace_back(left.xm, left.ym);
+        samples.emplace_back(right.xm, right.ym);
+
+        left.error = DeviationPx(left, sx, sy);
+        right.error = DeviationPx(right, sx, sy);
+        queue.push(left);
+        queue.push(right);
+    }
+
+    std::sort(samples.begin(), samples.end(),
+              [](const std::pair<double, double>& a,
+                 const std::pair<double, double>& b) {
+                  return a.first < b.first;
+              });
+
+    xs->resize(samples.size());
+    ys->resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        (*xs)[i] = samples[i].first;
+        (*ys)[i] = samples[i].second;
+    }
+
+    return evaluations;
+}
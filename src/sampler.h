@@ -0,0 +1,135 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "thread_pool.h"
+
+struct AdaptiveSampling
+{
+    // max distance in pixels between the drawn polyline and the function
+    double tolerance_px=0.5;
+
+    // hard limit on calls to the generator, the initial grid included,
+    // except that the smallest grid of one interval takes 3 calls
+    uint32_t max_evaluations=2048;
+
+    // uniform intervals evaluated before refinement starts, fewer if the
+    // budget is smaller; features narrower than one of them may be missed
+    uint32_t initial_intervals=16;
+
+    // plot area the tolerance refers to
+    double width_px=640.0;
+    double height_px=480.0;
+
+    // y range shown by the plot; when equal it is taken from the initial grid
+    double y_min=0.0;
+    double y_max=0.0;
+};
+
+/**
+ * @brief Samples gen over [xmin, xmax], refining where the polyline through
+ * the samples deviates from the function by more than the pixel tolerance.
+ *
+ * Intervals are refined worst first, so a tight evaluation budget is spent
+ * on the sharpest features. Output is sorted by x.
+ *
+ * @return The number of generator evaluations used.
+ */
+uint32_t SampleFunctionAdaptive(const std::function<double(double)>& gen,
+    double xmin, double xmax, const AdaptiveSampling& sampling,
+    std::vector<double>* xs, std::vector<double>* ys);
+
+// Writes num+1 evenly spaced points over [xmin, xmax] to xs. Each point is
+// computed from its index, so the last one lands exactly on xmax.
+inline void UniformGrid(double xmin, double xmax, uint32_t num, double* xs)
+{
+    if (num == 0)
+    {
+        xs[0] = xmin;
+        return;
+    }
+
+    const double xstep = (xmax - xmin) / num;
+    for (uint32_t i = 0; i < num; i++)
+        xs[i] = xmin + xstep * i;
+    xs[num] = xmax;
+}
+
+/**
+ * @brief Samples gen at num+1 uniform points straight into xs/ys, which must
+ * hold num+1 values each. gen is a template parameter, so plain lambdas are
+ * inlined into the loop instead of being called through std::function.
+ */
+template <typename Gen>
+void SampleFunction(const Gen& gen, uint32_t num, double xmin, double xmax,
+    double* xs, double* ys)
+{
+    UniformGrid(xmin, xmax, num, xs);
+    for (size_t i = 0; i <= num; i++)
+        ys[i] = gen(xs[i]);
+}
+
+/**
+ * @brief Same as SampleFunction, but hands the whole grid to a batch
+ * generator with the signature void(const double* xs, double* ys, size_t n).
+ */
+template <typename BatchGen>
+void SampleFunctionBatch(const BatchGen& gen, uint32_t num, double xmin,
+    double xmax, double* xs, double* ys)
+{
+    UniformGrid(xmin, xmax, num, xs);
+    gen(xs, ys, size_t(num) + 1);
+}
+
+// Grid chunk per worker task: small enough to balance expensive generators,
+// large enough that cheap ones are not dominated by scheduling.
+inline size_t SamplingGrain(size_t count)
+{
+    const size_t per_task = count / (size_t(ParallelWorkers()) * 8);
+    return per_task < 16 ? 16 : per_task;
+}
+
+/**
+ * @brief SampleFunction spread over the worker pool. Every sample is written
+ * to its own slot, so the output does not depend on scheduling. gen is
+ * called concurrently and must be safe to do so.
+ */
+template <typename Gen>
+void SampleFunctionParallel(const Gen& gen, uint32_t num, double xmin,
+    double xmax, double* xs, double* ys)
+{
+    UniformGrid(xmin, xmax, num, xs);
+    ParallelFor(0, size_t(num) + 1, SamplingGrain(size_t(num) + 1),
+                [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++)
+                        ys[i] = gen(xs[i]);
+                });
+}
+
+// SampleFunctionBatch spread over the worker pool, one batch per chunk.
+template <typename BatchGen>
+void SampleFunctionBatchParallel(const BatchGen& gen, uint32_t num,
+    double xmin, double xmax, double* xs, double* ys)
+{
+    UniformGrid(xmin, xmax, num, xs);
+    ParallelFor(0, size_t(num) + 1, SamplingGrain(size_t(num) + 1),
+                [&](size_t begin, size_t end) {
+                    gen(xs + begin, ys + begin, end - begin);
+                });
+}
+
+// Built-in batch generators. They are branch free polynomial approximations
+// the compiler can vectorize, accurate to a few ulp of the std:: functions;
+// arguments outside their reduction range fall back to the std:: versions.
+void SinBatch(const double* xs, double* ys, size_t n);
+void CosBatch(const double* xs, double* ys, size_t n);
+void ExpBatch(const double* xs, double* ys, size_t n);
+
+// coeffs[0] + coeffs[1]*x + coeffs[2]*x^2 + ...
+void PolynomialBatch(const std::vector<double>& coeffs, const double* xs,
+    double* ys, size_t n);
+
+#endif // SAMPLER_H
@@ -0,0 +1,328 @@
+#include "series_tiles.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace {
+
+// Shapes are clipped this far outside a tile, so lines and markers of
+// points just outside still reach into it.
+const double TILE_MARGIN = 16.0;
+
+Color8 SeriesColor(const PlotSeries& s)
+{
+    Color8 color;
+    color.r = (uint8_t)std::lround(std::min(std::max(s.rgb[0], 0.f), 1.f) * 255.f);
+    color.g = (uint8_t)std::lround(std::min(std::max(s.rgb[1], 0.f), 1.f) * 255.f);
+    color.b = (uint8_t)std::lround(std::min(std::max(s.rgb[2], 0.f), 1.f) * 255.f);
+    return color;
+}
+
+// x / 2^levels rounded down, for negative x as well.
+int64_t FloorShift(int64_t x, int levels)
+{
+    const int64_t d = int64_t(1) << levels;
+    return x >= 0 ? x / d : -((-x + d - 1) / d);
+}
+
+struct TileRenderer
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+
+    std::shared_ptr<const PlotSeriesList> series;
+    std::vector<TileKey> pending;
+    std::vector<TileKey> running;
+    std::vector<SeriesTile> finished;
+
+    // Must be called with the mutex held.
+    void Start()
+    {
+        if (!thread.joinable() && !stop)
+            thread = std::thread([this] { Work(); });
+    }
+
+    void Work()
+    {
+        for (;;)
+        {
+            std::shared_ptr<const PlotSeriesList> list;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stop || !pending.empty(); });
+                if (stop)
+                    return;
+
+                // a batch of one tile per worker, so new requests wait for
+                // at most one tile each
+                const size_t n = std::min<size_t>(pending.size(),
+                                                  ParallelWorkers());
+                running.assign(pending.begin(), pending.begin() + n);
+                pending.erase(pending.begin(), pending.begin() + n);
+                list = series;
+            }
+
+            std::vector<SeriesTile> tiles(running.size());
+            try
+            {
+                ParallelFor(0, tiles.size(), 1, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        tiles[i].key = running[i];
+                        RenderSeriesTile(*list, running[i], &tiles[i].canvas);
+                    }
+                });
+            }
+            catch (const std::exception&)
+            {
+                tiles.clear();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (SeriesTile& tile : tiles)
+            {
+                if (tile.key.version == series->version)
+                    finished.push_back(std::move(tile));
+            }
+            running.clear();
+        }
+    }
+};
+
+TileRenderer& Renderer()
+{
+    static TileRenderer renderer;
+    return renderer;
+}
+
+}
+
+bool operator<(const TileKey& a, const TileKey& b)
+{
+    return std::tie(a.version, a.level, a.y, a.x)
+        < std::tie(b.version, b.level, b.y, b.x);
+}
+
+bool operator==(const TileKey& a, const TileKey& b)
+{
+    return a.version == b.version && a.level == b.level && a.x == b.x
+        && a.y == b.y;
+}
+
+PlotView HomeView(const PlotSeriesList& list)
+{
+    PlotView view;
+    view.x = list.origin_x * list.transform.x_scale + list.transform.x_offset;
+    view.y = list.origin_y * list.transform.y_scale + list.transform.y_offset;
+    return view;
+}
+
+void ZoomView(PlotView* view, double factor, double px, double py)
+{
+    const double zoom = std::min(std::max(view->zoom * factor,
+                                          PLOT_VIEW_MIN_ZOOM),
+                                 PLOT_VIEW_MAX_ZOOM);
+    const double k = zoom / view->zoom;
+
+    view->x = px - (px - view->x) * k;
+    view->y = py - (py - view->y) * k;
+    view->zoom = zoom;
+}
+
+void ViewRange(const PlotSeriesList& list, const PlotView& view, double* xmin,
+    double* xmax, double* ymin, double* ymax)
+{
+    const PixelTransform& t = list.transform;
+    const double sx = t.x_scale * view.zoom;
+    const double sy = t.y_scale * view.zoom;
+
+    const double x0 = list.origin_x + (t.x_min - view.x) / sx;
+    const double x1 = list.origin_x + (t.x_max - view.x) / sx;
+    const double y0 = list.origin_y + (t.y_min - view.y) / sy;
+    const double y1 = list.origin_y + (t.y_max - view.y) / sy;
+
+    *xmin = std::min(x0, x1);
+    *xmax = std::max(x0, x1);
+    *ymin = std::min(y0, y1);
+    *ymax = std::max(y0, y1);
+}
+
+int ViewLevel(const PlotView& view)
+{
+    return (int)std::lround(std::log2(view.zoom));
+}
+
+void ViewTiles(const PlotSeriesList& list, const PlotView& view,
+    std::vector<TileKey>* keys)
+{
+    const PixelTransform& t = list.transform;
+    TileKey key;
+    key.level = ViewLevel(view);
+    key.version = list.version;
+
+    // image pixels per tile
+    const double size = SERIES_TILE * view.zoom / std::ldexp(1.0, key.level);
+    const int64_t x0 = (int64_t)std::floor((t.x_min - view.x) / size);
+    const int64_t x1 = (int64_t)std::ceil((t.x_max - view.x) / size);
+    const int64_t y0 = (int64_t)std::floor((t.y_min - view.y) / size);
+    const int64_t y1 = (int64_t)std::ceil((t.y_max - view.y) / size);
+
+    keys->clear();
+    for (key.y = y0; key.y < y1; key.y++)
+    {
+        for (key.x = x0; key.x < x1; key.x++)
+            keys->push_back(key);
+    }
+}
+
+void TileRect(const TileKey& key, const PlotView& view, double* x0,
+    double* y0, double* x1, double* y1)
+{
+    const double size = SERIES_TILE * view.zoom / std::ldexp(1.0, key.level);
+
+    *x0 = view.x + key.x * size;
+    *y0 = view.y + key.y * size;
+    *x1 = *x0 + size;
+    *y1 = *y0 + size;
+}
+
+TileKey ParentTile(const TileKey& key, int levels)
+{
+    TileKey parent = key;
+    parent.level -= levels;
+    parent.x = FloorShift(key.x, levels);
+    parent.y = FloorShift(key.y, levels);
+    return parent;
+}
+
+void RenderSeriesTile(const PlotSeriesList& list, const TileKey& key,
+    Canvas* tile)
+{
+    const double scale = std::ldexp(1.0, key.level);
+    Color8 clear;
+    clear.a = 0;
+    ResizeCanvas(tile, SERIES_TILE, SERIES_TILE, clear);
+
+    // the points are relative to the origin already
+    PixelTransform t;
+    t.x_scale = list.transform.x_scale * scale;
+    t.x_offset = -double(key.x) * SERIES_TILE;
+    t.y_scale = list.transform.y_scale * scale;
+    t.y_offset = -double(key.y) * SERIES_TILE;
+    t.x_min = t.y_min = -TILE_MARGIN;
+    t.x_max = t.y_max = SERIES_TILE + TILE_MARGIN;
+
+    RasterList raster;
+    std::vector<double> xs, ys, scratch;
+    std::vector<PixelSegment> segments;
+
+    for (const PlotSeries& s : list.series)
+    {
+        const size_t n = s.xy.size() / 2;
+        const Color8 color = SeriesColor(s);
+
+        if (s.lines)
+        {
+            xs.resize(n);
+            ys.resize(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                xs[i] = s.xy[i * 2];
+                ys[i] = s.xy[i * 2 + 1];
+            }
+
+            double offset = 0.0;
+            const uint32_t style =
+                RasterAddStyle(&raster, color, s.size, s.pattern);
+            ClipPolyline(xs.data(), ys.data(), n, t, &scratch, &segments);
+            RasterAddLines(&raster, style, segments.data(), segments.size(),
+                           &offset);
+        }
+        else
+        {
+            const uint32_t style = RasterAddStyle(&raster, color, 1.0);
+            for (size_t i = 0; i < n; i++)
+            {
+                const double x = s.xy[i * 2] * t.x_scale + t.x_offset;
+                const double y = s.xy[i * 2 + 1] * t.y_scale + t.y_offset;
+                if (x > t.x_min && x < t.x_max && y > t.y_min && y < t.y_max)
+                {
+                    RasterAddMarker(&raster, style, s.marker,
+                                    (int)std::floor(x), (int)std::floor(y), 3);
+                }
+            }
+        }
+    }
+
+    RasterDraw(tile, &raster);
+}
+
+void SetTileSeries(const PlotSeriesList& list)
+{
+    std::shared_ptr<const PlotSeriesList> copy =
+        std::make_shared<const PlotSeriesList>(list);
+    TileRenderer& r = Renderer();
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.series = copy;
+    r.pending.clear();
+    r.finished.clear();
+}
+
+void RequestTiles(const std::vector<TileKey>& keys)
+{
+    TileRenderer& r = Renderer();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    r.pending.clear();
+    if (!r.series)
+        return;
+
+    for (const TileKey& key : keys)
+    {
+        if (key.version != r.series->version
+            || std::find(r.running.begin(), r.running.end(), key)
+                != r.running.end()
+            || std::any_of(r.finished.begin(), r.finished.end(),
+                           [&](const SeriesTile& t) { return t.key == key; }))
+            continue;
+        r.pending.push_back(key);
+    }
+
+    if (!r.pending.empty())
+    {
+        r.Start();
+        r.wake.notify_one();
+    }
+}
+
+void TakeFinishedTiles(std::vector<SeriesTile>* tiles)
+{
+    TileRenderer& r = Renderer();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (SeriesTile& tile : r.finished)
+        tiles->push_back(std::move(tile));
+    r.finished.clear();
+}
+
+void StopTileRenderer()
+{
+    TileRenderer& r = Renderer();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.stop = true;
+    }
+    r.wake.notify_one();
+    if (r.thread.joinable())
+        r.thread.join();
+}
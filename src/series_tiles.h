@@ -0,0 +1,97 @@
+#ifndef SERIES_TILES_H
+#define SERIES_TILES_H
+
+#include <cstdint>
+#include <vector>
+#include "plotter.h"
+
+// Side length in pixels of the square tiles the recorded series are
+// rasterized in for panning and zooming.
+const int SERIES_TILE = 256;
+
+// Pan and zoom of the recorded series relative to the plot they were
+// recorded with. A point maps to the image pixel
+//     ((x - origin_x) * x_scale * zoom + x, (y - origin_y) * y_scale * zoom + y)
+// with origin and scale from plot_series.
+struct PlotView
+{
+    double zoom=1.0;
+    double x=0.0;
+    double y=0.0;
+};
+
+// Zoom is limited by the float precision of the recorded points.
+const double PLOT_VIEW_MIN_ZOOM = 1.0 / 1024.0;
+const double PLOT_VIEW_MAX_ZOOM = 65536.0;
+
+// A tile of the series at a power of two zoom level, as the series were at
+// version. At level z the tile covers the pixels [x, x + 1) * SERIES_TILE
+// by [y, y + 1) * SERIES_TILE of the series drawn at zoom 2^z with the
+// origin at pixel (0, 0).
+struct TileKey
+{
+    int level=0;
+    int64_t x=0;
+    int64_t y=0;
+    uint64_t version=0;
+};
+
+bool operator<(const TileKey& a, const TileKey& b);
+bool operator==(const TileKey& a, const TileKey& b);
+
+struct SeriesTile
+{
+    TileKey key;
+    Canvas canvas;
+};
+
+// View showing the series as they were plotted.
+PlotView HomeView(const PlotSeriesList& list);
+
+// Zooms by factor keeping the image pixel (px, py) in place.
+void ZoomView(PlotView* view, double factor, double px, double py);
+
+// Plot range shown in the plot area of the image.
+void ViewRange(const PlotSeriesList& list, const PlotView& view, double* xmin,
+    double* xmax, double* ymin, double* ymax);
+
+// Tile level closest to the zoom of the view.
+int ViewLevel(const PlotView& view);
+
+// Tiles of the level of the view that cover the plot area, rows from the
+// top, each row left to right.
+void ViewTiles(const PlotSeriesList& list, const PlotView& view,
+    std::vector<TileKey>* keys);
+
+// Image pixel rectangle a tile covers in the view.
+void TileRect(const TileKey& key, const PlotView& view, double* x0,
+    double* y0, double* x1, double* y1);
+
+// The tile levels up containing the given one.
+TileKey ParentTile(const TileKey& key, int levels);
+
+/**
+ * @brief Rasterizes one tile of the series with the same primitives as the
+ * plot image, into a transparent SERIES_TILE x SERIES_TILE canvas. Dash
+ * patterns restart in every tile.
+ */
+void RenderSeriesTile(const PlotSeriesList& list, const TileKey& key,
+    Canvas* tile);
+
+/**
+ * @brief Background tile rendering.
+ *
+ * SetTileSeries hands a copy of the series to a background thread, which
+ * renders the tiles asked for with RequestTiles on the worker pool.
+ * Rendered tiles are collected with TakeFinishedTiles. Requests replace the
+ * ones not started yet, and requests for other versions than the last one
+ * set are dropped.
+ */
+void SetTileSeries(const PlotSeriesList& list);
+void RequestTiles(const std::vector<TileKey>& keys);
+void TakeFinishedTiles(std::vector<SeriesTile>* tiles);
+
+// Waits for the background thread to finish; must be called before exit.
+void StopTileRenderer();
+
+#endif // SERIES_TILES_H
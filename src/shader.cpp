@@ -0,0 +1,144 @@
+#include "shader.h"
+
+#include <cstring>
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_INVALID_INDEX
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+
+namespace {
+
+typedef GLuint (APIENTRYP GetUniformBlockIndexProc)(GLuint program,
+                                                    const GLchar* name);
+typedef void (APIENTRYP UniformBlockBindingProc)(GLuint program,
+                                                 GLuint block_index,
+                                                 GLuint binding);
+
+GetUniformBlockIndexProc get_uniform_block_index_ = nullptr;
+UniformBlockBindingProc uniform_block_binding_ = nullptr;
+
+// The info log of a shader or program, whichever the getters are for.
+template <typename GetIv, typename GetLog>
+std::string InfoLog(GLuint object, GetIv get_iv, GetLog get_log)
+{
+    GLint length = 0;
+    get_iv(object, GL_INFO_LOG_LENGTH, &length);
+    std::string log(length > 0 ? length : 0, '\0');
+    if (length > 0)
+        get_log(object, length, nullptr, &log[0]);
+    return log;
+}
+
+// 0 with the compile log in error if the source does not compile.
+GLuint CompileShader(GLenum type, const char* source, std::string* error)
+{
+    const GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled != GL_TRUE)
+    {
+        *error = (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
+            + std::string(" shader: ")
+            + InfoLog(shader, glGetShaderiv, glGetShaderInfoLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+}
+
+bool LoadShaderFunctions(GLADloadproc load)
+{
+    get_uniform_block_index_ =
+        (GetUniformBlockIndexProc)load("glGetUniformBlockIndex");
+    uniform_block_binding_ =
+        (UniformBlockBindingProc)load("glUniformBlockBinding");
+    return get_uniform_block_index_ && uniform_block_binding_;
+}
+
+bool CreateShaderProgram(ShaderProgram* program, const char* vertex_source,
+    const char* fragment_source, std::string* error)
+{
+    const GLuint vertex = CompileShader(GL_VERTEX_SHADER, vertex_source, error);
+    if (!vertex)
+        return false;
+    const GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, fragment_source,
+                                          error);
+    if (!fragment)
+    {
+        glDeleteShader(vertex);
+        return false;
+    }
+
+    const GLuint id = glCreateProgram();
+    glAttachShader(id, vertex);
+    glAttachShader(id, fragment);
+    glLinkProgram(id);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        *error = "program: " + InfoLog(id, glGetProgramiv, glGetProgramInfoLog);
+        glDeleteProgram(id);
+        return false;
+    }
+
+    program->id = id;
+    program->object_color = glGetUniformLocation(id, "objectColor");
+
+    const GLuint block = get_uniform_block_index_(id, "Projection");
+    if (block != GL_INVALID_INDEX)
+        uniform_block_binding_(id, block, PROJECTION_BINDING);
+
+    return true;
+}
+
+void DestroyShaderProgram(ShaderProgram* program)
+{
+    if (program->id)
+        glDeleteProgram(program->id);
+    *program = ShaderProgram();
+}
+
+void CreateProjectionBuffer(ProjectionBuffer* buffer)
+{
+    for (int i = 0; i < 16; i++)
+        buffer->projection[i] = i % 5 == 0 ? 1.f : 0.f;
+
+    glGenBuffers(1, &buffer->ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(buffer->projection),
+                 buffer->projection, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, PROJECTION_BINDING, buffer->ubo);
+}
+
+void DestroyProjectionBuffer(ProjectionBuffer* buffer)
+{
+    if (buffer->ubo)
+        glDeleteBuffers(1, &buffer->ubo);
+    *buffer = ProjectionBuffer();
+}
+
+void SetProjection(ProjectionBuffer* buffer, const float projection[4][4])
+{
+    if (std::memcmp(buffer->projection, projection,
+                    sizeof(buffer->projection)) == 0)
+        return;
+
+    std::memcpy(buffer->projection, projection, sizeof(buffer->projection));
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(buffer->projection),
+                    buffer->projection);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,60 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <string>
+#include <glad/glad.h>
+
+// Binding point of the Projection uniform block, which every program shares
+// through one ProjectionBuffer:
+//
+//   layout (std140) uniform Projection { mat4 projection; };
+const unsigned int PROJECTION_BINDING = 0;
+
+struct ShaderProgram
+{
+    unsigned int id=0;
+
+    // uniform locations, looked up once at link time; -1 where the
+    // program has no such uniform
+    int object_color=-1;
+};
+
+// Uniform buffer backing the Projection block.
+struct ProjectionBuffer
+{
+    unsigned int ubo=0;
+
+    // what the buffer holds, so setting the same projection again is free
+    float projection[16]={};
+};
+
+/**
+ * @brief Loads the uniform buffer functions of GL 3.1, which the GL 3.0
+ * loader leaves out. Call once the context is current.
+ * @return false if the driver lacks them.
+ */
+bool LoadShaderFunctions(GLADloadproc load);
+
+/**
+ * @brief Compiles and links a program from the given sources, looks up its
+ * uniforms and binds its Projection block to PROJECTION_BINDING.
+ * @return false with the compile or link log in error.
+ */
+bool CreateShaderProgram(ShaderProgram* program, const char* vertex_source,
+    const char* fragment_source, std::string* error);
+
+void DestroyShaderProgram(ShaderProgram* program);
+
+// Creates the buffer, holding the identity, and binds it to
+// PROJECTION_BINDING.
+void CreateProjectionBuffer(ProjectionBuffer* buffer);
+
+void DestroyProjectionBuffer(ProjectionBuffer* buffer);
+
+/**
+ * @brief Sets the projection of every program from now on, column major
+ * like glUniformMatrix4fv takes it.
+ */
+void SetProjection(ProjectionBuffer* buffer, const float projection[4][4]);
+
+#endif // SHADER_H
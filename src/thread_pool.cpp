@@ -0,0 +1,159 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+unsigned requested_workers_ = 0;
+thread_local bool in_worker_ = false;
+
+struct Pool
+{
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+
+    explicit Pool(unsigned count)
+    {
+        for (unsigned i = 0; i < count; i++)
+            threads.emplace_back([this] { Work(); });
+    }
+
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void Push(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    void Work()
+    {
+        in_worker_ = true;
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stop || !tasks.empty(); });
+                if (stop && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// The calling thread takes part in every ParallelFor, hence one less.
+Pool& SharedPool()
+{
+    static Pool pool(ParallelWorkers() - 1);
+    return pool;
+}
+
+// State shared by the threads working on one ParallelFor call.
+struct Job
+{
+    std::atomic<size_t> next{ 0 };
+    std::mutex mutex;
+    std::condition_variable finished;
+    unsigned helpers = 0;
+    std::exception_ptr error;
+};
+
+}
+
+void SetParallelWorkers(unsigned count)
+{
+    requested_workers_ = count;
+}
+
+unsigned ParallelWorkers()
+{
+    unsigned count = requested_workers_;
+    if (count == 0)
+        count = std::thread::hardware_concurrency();
+    return std::max(1u, count);
+}
+
+void ParallelFor(size_t begin, size_t end, size_t grain,
+    const std::function<void(size_t, size_t)>& body)
+{
+    if (end <= begin)
+        return;
+
+    grain = std::max<size_t>(1, grain);
+    const size_t chunks = (end - begin + grain - 1) / grain;
+    const unsigned workers = ParallelWorkers();
+
+    if (chunks == 1 || workers == 1 || in_worker_)
+    {
+        body(begin, end);
+        return;
+    }
+
+    Job job;
+    auto run = [&] {
+        for (;;)
+        {
+            const size_t c = job.next.fetch_add(1);
+            if (c >= chunks)
+                break;
+
+            const size_t b = begin + c * grain;
+            try
+            {
+                body(b, std::min(end, b + grain));
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if (!job.error)
+                    job.error = std::current_exception();
+            }
+        }
+    };
+
+    job.helpers = (unsigned)std::min<size_t>(workers - 1, chunks - 1);
+    for (unsigned i = 0, n = job.helpers; i < n; i++)
+    {
+        SharedPool().Push([&] {
+            run();
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (--job.helpers == 0)
+                job.finished.notify_one();
+        });
+    }
+
+    run();
+
+    // Helpers reference job and body, so wait for all of them to leave.
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.finished.wait(lock, [&] { return job.helpers == 0; });
+
+    if (job.error)
+        std::rethrow_exception(job.error);
+}
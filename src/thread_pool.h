@@ -0,0 +1,29 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * @brief Sets the number of threads ParallelFor may use, the calling thread
+ * included. 0 picks std::thread::hardware_concurrency(). Every ParallelFor
+ * reads it again to pick its helpers and whether to run serially, but the
+ * pool's threads are started on first use, so a count raised after that
+ * queues the extra helpers on the threads already there.
+ */
+void SetParallelWorkers(unsigned count);
+unsigned ParallelWorkers();
+
+/**
+ * @brief Splits [begin, end) into chunks of at most grain indices and runs
+ * body(chunk_begin, chunk_end) on the shared worker pool, the calling thread
+ * included. Returns once every chunk is done; the first exception thrown by
+ * body is rethrown here.
+ *
+ * Calls made from inside a worker run serially on that worker, so nested
+ * use cannot deadlock the pool.
+ */
+void ParallelFor(size_t begin, size_t end, size_t grain,
+    const std::function<void(size_t, size_t)>& body);
+
+#endif // THREAD_POOL_H